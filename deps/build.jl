@@ -111,9 +111,11 @@ else
 end
 
 build_type = get(ENV, "CXXWRAP_BUILD_TYPE", "Release")
+# Set to OFF to build without Qt Widgets, always using a QGuiApplication
+use_widgets = get(ENV, "QML_USE_WIDGETS", "ON")
 
 qml_steps = @build_steps begin
-	`cmake -G "$genopt" -DCMAKE_INSTALL_PREFIX="$prefix" -DCMAKE_BUILD_TYPE="$build_type" -DCMAKE_PREFIX_PATH="$cmake_prefix" -DCxxWrap_DIR="$cxx_wrap_dir" $qmlwrap_srcdir`
+	`cmake -G "$genopt" -DCMAKE_INSTALL_PREFIX="$prefix" -DCMAKE_BUILD_TYPE="$build_type" -DCMAKE_PREFIX_PATH="$cmake_prefix" -DCxxWrap_DIR="$cxx_wrap_dir" -DQML_USE_WIDGETS="$use_widgets" $qmlwrap_srcdir`
 	`cmake --build . --config $build_type --target install $makeopts`
 end
 
@@ -1,11 +1,58 @@
+#include <cmath>
+
+#include <QDirIterator>
+#include <QFileInfo>
+#ifndef QML_NO_WIDGETS
+#include <QApplication>
+#endif
+
 #include "application_manager.hpp"
+#include "frame_scheduler.hpp"
+#include "gc_root_arena.hpp"
 #include "julia_api.hpp"
 #include "julia_object.hpp"
+#include "offscreen_renderer.hpp"
+#include "profiler.hpp"
+#ifdef QML_UV_EVENT_DISPATCHER
+#include "uv_event_dispatcher.hpp"
+#endif
 
 
 namespace qmlwrap
 {
 
+namespace detail
+{
+  // Value of a context property of ctx for the Julia value v, or an invalid QVariant if the type is not supported
+  QVariant context_property_value(QQmlContext* ctx, jl_value_t* v)
+  {
+    if(jl_type_morespecific(jl_typeof(v), (jl_value_t*)cxx_wrap::julia_type<QObject>()))
+    {
+      // Protect object from garbage collection in case the caller did not bind it to a Julia variable, using the roots of the engine
+      GCRootArena* gc_roots = GCRootArena::of(ctx->engine() != nullptr ? static_cast<QObject*>(ctx->engine()) : ctx, "engine");
+      const GCRootArena::Handle root = gc_roots->protect(v);
+
+      // Make sure it gets freed on context destruction. The connection is dropped if the engine goes first, which releases all its roots.
+      QObject::connect(ctx, &QQmlContext::destroyed, gc_roots, [gc_roots, root] (QObject*) { gc_roots->release(root); });
+
+      return QVariant::fromValue(cxx_wrap::convert_to_cpp<QObject*>(v));
+    }
+
+    QVariant qt_var = cxx_wrap::convert_to_cpp<QVariant>(v);
+    if(!qt_var.isNull())
+    {
+      return qt_var;
+    }
+
+    if(jl_is_structtype(jl_typeof(v)))
+    {
+      // ctx owns the JuliaObject, so cleanup is automatic. Setting the same object again reuses its wrapper.
+      return QVariant::fromValue(static_cast<QObject*>(qmlwrap::JuliaObject::wrap(v, ctx)));
+    }
+    return QVariant();
+  }
+}
+
 void set_context_property(QQmlContext* ctx, const QString& name, jl_value_t* v)
 {
   if(ctx == nullptr)
@@ -14,32 +61,51 @@ void set_context_property(QQmlContext* ctx, const QString& name, jl_value_t* v)
     return;
   }
 
-  if(jl_type_morespecific(jl_typeof(v), (jl_value_t*)cxx_wrap::julia_type<QObject>()))
+  const QVariant value = detail::context_property_value(ctx, v);
+  if(!value.isValid())
   {
-    // Protect object from garbage collection in case the caller did not bind it to a Julia variable
-    cxx_wrap::protect_from_gc(v);
-
-    // Make sure it gets freed on context destruction
-    QObject::connect(ctx, &QQmlContext::destroyed, [=] (QObject*) { cxx_wrap::unprotect_from_gc(v); });
-
-    ctx->setContextProperty(name, cxx_wrap::convert_to_cpp<QObject*>(v));
+    qWarning() << "Unsupported type for context property " << name;
     return;
   }
+  ctx->setContextProperty(name, value);
+}
 
-  QVariant qt_var = cxx_wrap::convert_to_cpp<QVariant>(v);
-  if(!qt_var.isNull())
+void set_context_properties(QQmlContext* ctx, cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> properties)
+{
+  if(property_names.size() != properties.size())
+  {
+    throw std::runtime_error("Property names and properties arrays sizes dont't match");
+  }
+  if(ctx == nullptr)
   {
-    ctx->setContextProperty(name, qt_var);
+    qWarning() << "Can't set properties on null context";
     return;
   }
 
-  if(jl_is_structtype(jl_typeof(v)))
+  const std::size_t nb_props = properties.size();
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 11, 0))
+  // Setting all properties at once re-evaluates the bindings that depend on them only once
+  QVector<QQmlContext::PropertyPair> pairs;
+  pairs.reserve(nb_props);
+  for(std::size_t i = 0; i != nb_props; ++i)
   {
-    // ctx is the parent for the JuliaObject, so cleanup is automatic
-    ctx->setContextProperty(name, new qmlwrap::JuliaObject(v, ctx));
-    return;
+    const QString name = cxx_wrap::convert_to_cpp<QString>(property_names[i]);
+    const QVariant value = detail::context_property_value(ctx, properties[i]);
+    if(!value.isValid())
+    {
+      qWarning() << "Unsupported type for context property " << name;
+      continue;
+    }
+    pairs.push_back({name, value});
+  }
+  ctx->setContextProperties(pairs);
+#else
+  // Bindings are re-evaluated for each property before Qt 5.11
+  for(std::size_t i = 0; i != nb_props; ++i)
+  {
+    set_context_property(ctx, cxx_wrap::convert_to_cpp<QString>(property_names[i]), properties[i]);
   }
-  qWarning() << "Unsupported type for context property " << name;
+#endif
 }
 
 
@@ -54,7 +120,7 @@ ApplicationManager::~ApplicationManager()
 {
 }
 
-// Initialize the QApplication instance
+// Initialize the application instance, a QApplication unless QML_GUI_APPLICATION is set or widgets are disabled
 void ApplicationManager::init_application()
 {
   qputenv("QML_PREFIX_PATH", QProcessEnvironment::systemEnvironment().value("QML_PREFIX_PATH").toLocal8Bit());
@@ -67,13 +133,44 @@ void ApplicationManager::init_application()
   {
     cleanup();
   }
+  restart_startup_timing();
+
+  // The engine reads QML_DISK_CACHE_PATH itself, which only moves the QML disk cache and not the other cache locations of the application
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+  if(!QProcessEnvironment::systemEnvironment().value("QML_DISK_CACHE_PATH").isEmpty())
+  {
+    qWarning() << "QML_DISK_CACHE_PATH is not supported before Qt 5.15, using the default QML disk cache location";
+  }
+#endif
+
   static int argc = 1;
   static std::vector<char*> argv_buffer;
   if(argv_buffer.empty())
   {
     argv_buffer.push_back(const_cast<char*>("julia"));
   }
-  m_app = new QApplication(argc, &argv_buffer[0]);
+#ifdef QML_UV_EVENT_DISPATCHER
+  // Run Qt on the Julia event loop, unless QML_EVENT_DISPATCHER=qt selects the native event loop with polling in exec_async
+  if(jl_global_event_loop() != nullptr && qgetenv("QML_EVENT_DISPATCHER") != "qt")
+  {
+    m_uv_dispatcher = new UvEventDispatcher(jl_global_event_loop());
+    QCoreApplication::setEventDispatcher(m_uv_dispatcher);
+  }
+#endif
+#ifdef QML_NO_WIDGETS
+  m_app = new QGuiApplication(argc, &argv_buffer[0]);
+#else
+  // A QGuiApplication starts faster and uses less memory, but QtQuick Controls 1 then can't use the native widget style
+  const QByteArray gui_application = qgetenv("QML_GUI_APPLICATION");
+  if(!gui_application.isEmpty() && gui_application != "0")
+  {
+    m_app = new QGuiApplication(argc, &argv_buffer[0]);
+  }
+  else
+  {
+    m_app = new QApplication(argc, &argv_buffer[0]);
+  }
+#endif
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 4, 0))
   QSurfaceFormat format = QSurfaceFormat::defaultFormat();
   format.setProfile(QSurfaceFormat::CoreProfile);
@@ -84,12 +181,27 @@ void ApplicationManager::init_application()
 #else
   qWarning() << "Qt 5.4 is required to override OpenGL version, shader examples may fail";
 #endif
+  mark_startup_phase(InitApplication);
+
+  // Work may have been queued before this application existed
+  if(m_frame_scheduler != nullptr)
+  {
+    m_frame_scheduler->start_idle_timer();
+  }
 }
 
 // Init the app with a new QQmlApplicationEngine
 QQmlApplicationEngine* ApplicationManager::init_qmlapplicationengine()
 {
-  check_no_engine();
+  if(reuse_engine())
+  {
+    QQmlApplicationEngine* e = qobject_cast<QQmlApplicationEngine*>(m_engine);
+    if(e == nullptr)
+    {
+      throw std::runtime_error("The persistent engine is not a QQmlApplicationEngine");
+    }
+    return e;
+  }
   QQmlApplicationEngine* e = new QQmlApplicationEngine();
   set_engine(e);
   return e;
@@ -97,30 +209,33 @@ QQmlApplicationEngine* ApplicationManager::init_qmlapplicationengine()
 
 QQmlEngine* ApplicationManager::init_qmlengine()
 {
-  check_no_engine();
+  if(reuse_engine())
+  {
+    return m_engine;
+  }
   set_engine(new QQmlEngine());
   return m_engine;
 }
 
 QQuickView* ApplicationManager::init_qquickview()
 {
-  check_no_engine();
-  QQuickView* view = new QQuickView();
-  set_engine(view->engine());
+  QQuickView* view = nullptr;
+  if(reuse_engine())
+  {
+    view = new QQuickView(m_engine, nullptr);
+  }
+  else
+  {
+    view = new QQuickView();
+    set_engine(view->engine());
+  }
+  add_window(view);
   return view;
 }
 
 void ApplicationManager::add_context_properties(cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> properties)
 {
-  if(property_names.size() != properties.size())
-  {
-    throw std::runtime_error("Property names and properties arrays sizes dont't match");
-  }
-  const std::size_t nb_props = properties.size();
-  for(std::size_t i = 0; i != nb_props; ++i)
-  {
-    set_context_property(m_root_ctx, cxx_wrap::convert_to_cpp<QString>(property_names[i]), properties[i]);
-  }
+  set_context_properties(m_root_ctx, property_names, properties);
 }
 
 QQmlContext* ApplicationManager::root_context()
@@ -135,24 +250,311 @@ void ApplicationManager::exec()
   {
     throw std::runtime_error("App is not initialized, can't exec");
   }
+  frame_scheduler()->start_idle_timer();
   m_app->exec();
-  cleanup();
+  if(!m_persistent)
+  {
+    cleanup();
+  }
 }
 
-// Non-blocking exec, polling for Qt events in the uv event loop using a uv_timer_t
+// Non-blocking exec, handling Qt events from the uv event loop
 void ApplicationManager::exec_async()
 {
   if(jl_global_event_loop() == nullptr)
   {
     return;
   }
+#ifdef QML_UV_EVENT_DISPATCHER
+  if(m_uv_dispatcher != nullptr)
+  {
+    // Events are already handled whenever Julia waits for events, so only process what is pending now
+    m_uv_dispatcher->wakeUp();
+    return;
+  }
+#endif
+  // Fall back to polling for Qt events using a uv_timer_t
   m_timer = new uv_timer_t();
   uv_timer_init(jl_global_event_loop(), m_timer);
   uv_timer_start(m_timer, ApplicationManager::process_events, 15, 15);
 }
 
+FrameScheduler* ApplicationManager::frame_scheduler()
+{
+  if(m_frame_scheduler == nullptr)
+  {
+    m_frame_scheduler = new FrameScheduler();
+  }
+  return m_frame_scheduler;
+}
+
+void ApplicationManager::set_persistent(bool persistent)
+{
+  m_persistent = persistent;
+  if(!persistent && m_engine != nullptr)
+  {
+    // The engine is released the next time an application or engine is initialized
+    m_quit_called = true;
+  }
+}
+
+namespace detail
+{
+  QUrl qml_url(const QString& path)
+  {
+    const QUrl url(path);
+    // Single-letter schemes are Windows drive letters
+    if(url.isRelative() || url.scheme().size() == 1)
+    {
+      return QUrl::fromLocalFile(QFileInfo(path).absoluteFilePath());
+    }
+    return url;
+  }
+}
+
+QString component_errors(QQmlComponent* comp)
+{
+  QString result;
+  for(const QQmlError& error : comp->errors())
+  {
+    result += error.toString() + "\n";
+  }
+  return result;
+}
+
+QQmlComponent* ApplicationManager::component(const QString& path)
+{
+  // The same engine type as @qmlapp, so a persistent engine created here can be reused by init_qmlapplicationengine
+  if(m_engine == nullptr || m_quit_called)
+  {
+    init_qmlapplicationengine();
+  }
+
+  const QUrl url = detail::qml_url(path);
+  auto comp_it = m_components.constFind(url);
+  if(comp_it != m_components.constEnd())
+  {
+    return comp_it.value();
+  }
+
+  // The engine is the parent, so components are deleted together with it
+  QQmlComponent* comp = new QQmlComponent(m_engine, url, QQmlComponent::PreferSynchronous, m_engine);
+  if(comp->isError())
+  {
+    const QString errors = component_errors(comp);
+    delete comp;
+    throw std::runtime_error(("Error loading QML file " + url.toString() + ":\n" + errors).toStdString());
+  }
+  m_components[url] = comp;
+  return comp;
+}
+
+void ApplicationManager::invalidate_components(const QString& path)
+{
+  if(path.isEmpty())
+  {
+    qDeleteAll(m_components);
+    m_components.clear();
+  }
+  else
+  {
+    delete m_components.take(detail::qml_url(path));
+  }
+
+  // Also drop the types compiled by the engine itself, otherwise changed files are not reloaded
+  if(m_engine != nullptr)
+  {
+    m_engine->clearComponentCache();
+  }
+}
+
+QObject* ApplicationManager::open_window(const QString& path, cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> properties)
+{
+  if(property_names.size() != properties.size())
+  {
+    throw std::runtime_error("Property names and properties arrays sizes dont't match");
+  }
+
+  // A reused engine starts a new startup measurement with only the loading and the first frame
+  if(m_startup_ns[LoadQml].load() >= 0)
+  {
+    restart_startup_timing();
+  }
+
+  QQmlComponent* comp = component(path);
+
+  // Each window gets its own context, so windows opened at the same time can have different properties
+  QQmlContext* ctx = new QQmlContext(m_root_ctx);
+  set_context_properties(ctx, property_names, properties);
+
+  QObject* obj = comp->create(ctx);
+  if(obj == nullptr)
+  {
+    delete ctx;
+    throw std::runtime_error(("Error creating QML file " + path + ":\n" + component_errors(comp)).toStdString());
+  }
+  QQmlEngine::setObjectOwnership(obj, QQmlEngine::CppOwnership);
+
+  QQuickWindow* window = qobject_cast<QQuickWindow*>(obj);
+  QQuickItem* item = qobject_cast<QQuickItem*>(obj);
+  if(window == nullptr && item != nullptr)
+  {
+    window = new QQuickWindow();
+    item->setParentItem(window->contentItem());
+    item->setParent(window);
+    window->resize(std::max(1, int(item->width())), std::max(1, int(item->height())));
+    QObject::connect(window->contentItem(), &QQuickItem::widthChanged, item, [window, item]() { item->setWidth(window->contentItem()->width()); });
+    QObject::connect(window->contentItem(), &QQuickItem::heightChanged, item, [window, item]() { item->setHeight(window->contentItem()->height()); });
+    window->show();
+    obj = window;
+  }
+  ctx->setParent(obj);
+
+  if(window != nullptr)
+  {
+    add_window(window);
+    // Closing a window destroys it, the compiled component stays in the cache
+    QObject::connect(window, &QWindow::visibleChanged, window, [window](bool visible)
+    {
+      if(!visible)
+      {
+        window->deleteLater();
+      }
+    });
+  }
+  m_windows.push_back(obj);
+  return obj;
+}
+
+OffscreenRenderer* ApplicationManager::init_offscreen_renderer(int width, int height)
+{
+  if(m_engine == nullptr || m_quit_called)
+  {
+    init_qmlapplicationengine();
+  }
+  OffscreenRenderer* renderer = new OffscreenRenderer(width, height);
+  m_offscreen_renderers.push_back(renderer);
+  return renderer;
+}
+
+void ApplicationManager::close_windows()
+{
+  // This may be called from a signal of one of the windows, so deletion is deferred
+  for(const QPointer<QObject>& obj : m_windows)
+  {
+    if(obj.isNull())
+    {
+      continue;
+    }
+    QWindow* window = qobject_cast<QWindow*>(obj.data());
+    if(window != nullptr)
+    {
+      window->hide();
+    }
+    obj->deleteLater();
+  }
+  m_windows.clear();
+}
+
+bool ApplicationManager::reuse_engine()
+{
+  if(m_persistent && m_engine != nullptr && !m_quit_called)
+  {
+    return true;
+  }
+  check_no_engine();
+  return false;
+}
+
+void ApplicationManager::add_window(QQuickWindow* window)
+{
+  frame_scheduler()->add_window(window);
+  // Only the first frame of the current startup matters, so a single window is followed until it swaps a frame
+  if(m_startup_ns[FirstFrame].load() >= 0 || m_first_frame_connection)
+  {
+    return;
+  }
+  // frameSwapped comes from the render thread
+  m_first_frame_connection = QObject::connect(window, &QQuickWindow::frameSwapped, window, [this]()
+  {
+    mark_startup_phase(FirstFrame);
+    QObject::disconnect(m_first_frame_connection);
+  }, Qt::DirectConnection);
+}
+
+int ApplicationManager::precompile_qml(const QString& dir)
+{
+  if(!QFileInfo(dir).isDir())
+  {
+    throw std::runtime_error(("QML directory " + dir + " does not exist").toStdString());
+  }
+  init_application();
+
+  // A separate engine, so the compiled types don't stay in the type cache of the application engine
+  QQmlEngine engine;
+  int nb_compiled = 0;
+  QDirIterator it(dir, QStringList() << "*.qml", QDir::Files, QDirIterator::Subdirectories);
+  while(it.hasNext())
+  {
+    const QString path = it.next();
+    // Compiling a local file writes it to the disk cache, together with the QML files it imports
+    QQmlComponent comp(&engine, QUrl::fromLocalFile(QFileInfo(path).absoluteFilePath()), QQmlComponent::PreferSynchronous);
+    if(comp.isError())
+    {
+      qWarning() << "Error compiling" << path << ":" << comp.errors();
+      continue;
+    }
+    ++nb_compiled;
+  }
+  return nb_compiled;
+}
+
+void ApplicationManager::mark_startup_phase(StartupPhase phase)
+{
+  if(m_startup_ns[phase].load() >= 0)
+  {
+    return;
+  }
+  qint64 not_reached = -1;
+  m_startup_ns[phase].compare_exchange_strong(not_reached, m_startup_clock.nsecsElapsed());
+}
+
+void ApplicationManager::get_startup_timings(cxx_wrap::ArrayRef<double> timings) const
+{
+  if(timings.size() != NbStartupPhases)
+  {
+    throw std::runtime_error("Startup timings need an array of size " + std::to_string(NbStartupPhases));
+  }
+
+  // Each phase lasts from the end of the previous phase that happened
+  qint64 previous_ns = 0;
+  for(int i = 0; i != NbStartupPhases; ++i)
+  {
+    const qint64 end_ns = m_startup_ns[i].load();
+    if(end_ns < 0)
+    {
+      timings[i] = NAN;
+      continue;
+    }
+    timings[i] = std::max(qint64(0), end_ns - previous_ns) / 1e6;
+    previous_ns = std::max(previous_ns, end_ns);
+  }
+}
+
+void ApplicationManager::restart_startup_timing()
+{
+  for(std::atomic<qint64>& phase_ns : m_startup_ns)
+  {
+    phase_ns.store(-1);
+  }
+  // The next window added marks the first frame
+  QObject::disconnect(m_first_frame_connection);
+  m_startup_clock.start();
+}
+
 ApplicationManager::ApplicationManager()
 {
+  restart_startup_timing();
 }
 
 void ApplicationManager::cleanup()
@@ -162,8 +564,29 @@ void ApplicationManager::cleanup()
     return;
   }
   JuliaAPI::instance()->on_about_to_quit();
+  for(const QPointer<QObject>& obj : m_windows)
+  {
+    delete obj.data();
+  }
+  m_windows.clear();
+  // The scenes of the renderers belong to the engine
+  for(const QPointer<OffscreenRenderer>& renderer : m_offscreen_renderers)
+  {
+    delete renderer.data();
+  }
+  m_offscreen_renderers.clear();
+  m_components.clear();
   delete m_engine;
+  // The idle timer is registered with the event dispatcher of the application, the scheduler itself is kept
+  if(m_frame_scheduler != nullptr)
+  {
+    m_frame_scheduler->stop_idle_timer();
+  }
   delete m_app;
+#ifdef QML_UV_EVENT_DISPATCHER
+  // Closes the libuv handles, in case the application did not delete its dispatcher
+  delete m_uv_dispatcher.data();
+#endif
   m_engine = nullptr;
   m_app = nullptr;
   m_quit_called = false;
@@ -187,11 +610,32 @@ void ApplicationManager::check_no_engine()
 
 void ApplicationManager::set_engine(QQmlEngine* e)
 {
+  mark_startup_phase(CreateEngine);
   m_engine = e;
   m_root_ctx = e->rootContext();
+  QQmlApplicationEngine* app_engine = qobject_cast<QQmlApplicationEngine*>(e);
+  if(app_engine != nullptr)
+  {
+    QObject::connect(app_engine, &QQmlApplicationEngine::objectCreated, [this](QObject* obj, const QUrl&)
+    {
+      QQuickWindow* window = qobject_cast<QQuickWindow*>(obj);
+      if(window != nullptr)
+      {
+        add_window(window);
+      }
+    });
+  }
   QObject::connect(m_engine, &QQmlEngine::quit, [this]()
   {
-    m_quit_called = true;
+    // A persistent engine stays, only its windows are closed
+    if(m_persistent)
+    {
+      close_windows();
+    }
+    else
+    {
+      m_quit_called = true;
+    }
     if(m_timer != nullptr)
     {
       uv_timer_stop(m_timer);
@@ -203,8 +647,9 @@ void ApplicationManager::set_engine(QQmlEngine* e)
 
 void ApplicationManager::process_events(uv_timer_t* timer)
 {
-  QApplication::sendPostedEvents();
-  QApplication::processEvents(QEventLoop::AllEvents, 15);
+  profiler::Scope profile_scope(profiler::Category::Events, "process_events");
+  QCoreApplication::sendPostedEvents();
+  QCoreApplication::processEvents(QEventLoop::AllEvents, 15);
 }
 
 void ApplicationManager::handle_quit(uv_handle_t* handle)
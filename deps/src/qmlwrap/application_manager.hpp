@@ -1,8 +1,12 @@
 #ifndef QML_application_manager_H
 #define QML_application_manager_H
 
-#include <QApplication>
+#include <atomic>
+
+#include <QElapsedTimer>
+#include <QGuiApplication>
 #include <QLibraryInfo>
+#include <QPointer>
 #include <QQmlApplicationEngine>
 #include <QQmlComponent>
 #include <QQmlContext>
@@ -16,20 +20,39 @@
 namespace qmlwrap
 {
 
+class FrameScheduler;
+class OffscreenRenderer;
+class UvEventDispatcher;
+
 /// Helper to set context properties
 void set_context_property(QQmlContext* ctx, const QString& name, jl_value_t* v);
 
+/// Set several context properties at once, so bindings using them are re-evaluated only once (Qt 5.11 or later)
+void set_context_properties(QQmlContext* ctx, cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> properties);
+
+/// Errors of a component, one per line
+QString component_errors(QQmlComponent* comp);
+
 /// Manage creation and destruction of the application and the QML engine,
 class ApplicationManager
 {
 public:
+  /// Phases of the startup timing, in order
+  enum StartupPhase
+  {
+    InitApplication, // creation of the application
+    CreateEngine,    // creation of the QML engine
+    LoadQml,         // loading and creation of the QML
+    FirstFrame,      // until the first frame is swapped
+    NbStartupPhases
+  };
 
   // Singleton implementation
   static ApplicationManager& instance();
 
   ~ApplicationManager();
 
-  // Initialize the QApplication instance
+  // Initialize the application instance, a QApplication unless QML_GUI_APPLICATION is set or widgets are disabled
   void init_application();
 
   // Init the app with a new QQmlApplicationEngine
@@ -44,8 +67,45 @@ public:
   // Blocking call to exec, running the Qt event loop
   void exec();
 
-  // Non-blocking exec, polling for Qt events in the uv event loop using a uv_timer_t
+  // Non-blocking exec, handling Qt events from the uv event loop
   void exec_async();
+
+  // Scheduler for Julia work in between frames, following the windows of the engine
+  FrameScheduler* frame_scheduler();
+
+  // Keep the application and the engine alive when the application quits, so QML files can be reopened without recompiling
+  void set_persistent(bool persistent);
+  bool persistent() const
+  {
+    return m_persistent;
+  }
+
+  // Get the compiled component for a QML file, compiling it only the first time
+  QQmlComponent* component(const QString& path);
+
+  // Forget the compiled component of the given QML file, so it is reloaded from disk. An empty path clears all components.
+  void invalidate_components(const QString& path);
+
+  // Create the root object of a QML file in a new context with the given properties. A root item is shown in a new window.
+  QObject* open_window(const QString& path, cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> properties);
+
+  // Delete the windows created using open_window
+  void close_windows();
+
+  // Create a renderer for QML scenes that are not shown, using the engine of the application
+  OffscreenRenderer* init_offscreen_renderer(int width, int height);
+
+  // Follow the frames of a window of the application
+  void add_window(QQuickWindow* window);
+
+  // Compile the QML files in dir and its subdirectories, so they are stored in the QML disk cache. Returns the number of files compiled without errors.
+  int precompile_qml(const QString& dir);
+
+  // Record the end of a startup phase, if it was not recorded yet
+  void mark_startup_phase(StartupPhase phase);
+
+  // Write the duration in ms of each startup phase to timings, which must have NbStartupPhases elements. Phases that did not happen are NaN.
+  void get_startup_timings(cxx_wrap::ArrayRef<double> timings) const;
 private:
 
   ApplicationManager();
@@ -54,17 +114,36 @@ private:
 
   void check_no_engine();
 
+  // True if the persistent engine can be used instead of creating a new one
+  bool reuse_engine();
+
   void set_engine(QQmlEngine* e);
 
+  // Start measuring a new startup
+  void restart_startup_timing();
+
   static void process_events(uv_timer_t* timer);
 
   static void handle_quit(uv_handle_t* handle);
 
-  QApplication* m_app = nullptr;
+  QGuiApplication* m_app = nullptr;
   QQmlEngine* m_engine = nullptr;
   QQmlContext* m_root_ctx = nullptr;
   uv_timer_t* m_timer = nullptr;
+  // Event dispatcher running Qt on the Julia event loop
+  QPointer<UvEventDispatcher> m_uv_dispatcher;
+  // Kept when the application is recreated, so queued work and statistics are not lost
+  FrameScheduler* m_frame_scheduler = nullptr;
   bool m_quit_called = false;
+  bool m_persistent = false;
+  QHash<QUrl, QQmlComponent*> m_components;
+  QList<QPointer<QObject>> m_windows;
+  QList<QPointer<OffscreenRenderer>> m_offscreen_renderers;
+  // Time since the start of the startup at the end of each phase, or -1. The first frame is recorded from the render thread.
+  QElapsedTimer m_startup_clock;
+  std::atomic<qint64> m_startup_ns[NbStartupPhases];
+  // Marks the first frame, disconnected once it fired
+  QMetaObject::Connection m_first_frame_connection;
 };
 
 }
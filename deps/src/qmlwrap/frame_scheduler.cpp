@@ -0,0 +1,234 @@
+#include <algorithm>
+
+#include <QAbstractEventDispatcher>
+#include <QDebug>
+#include <QScreen>
+
+#include "frame_scheduler.hpp"
+
+namespace qmlwrap
+{
+
+namespace detail
+{
+  const qint64 default_frame_interval_ns = 16666667;
+}
+
+FrameScheduler::FrameScheduler(QObject* parent) : QObject(parent),
+  m_frame_start_ns(0),
+  m_swap_ns(0),
+  m_frame_interval_ns(detail::default_frame_interval_ns),
+  m_render_ns(0),
+  m_frame_work_pending(false)
+{
+  m_clock.start();
+  m_idle_timer.setSingleShot(true);
+  QObject::connect(&m_idle_timer, &QTimer::timeout, this, &FrameScheduler::run_idle_work);
+}
+
+FrameScheduler::~FrameScheduler()
+{
+  for(jl_function_t* f : m_work_items)
+  {
+    cxx_wrap::unprotect_from_gc(f);
+  }
+}
+
+void FrameScheduler::add_window(QQuickWindow* window)
+{
+  for(const QPointer<QQuickWindow>& w : m_windows)
+  {
+    if(w == window)
+    {
+      return;
+    }
+  }
+  m_windows.push_back(window);
+
+  if(window->screen() != nullptr && window->screen()->refreshRate() > 0 && m_nb_frames == 0)
+  {
+    m_frame_interval_ns.store(static_cast<qint64>(1e9 / window->screen()->refreshRate()));
+  }
+
+  // The scene graph signals may come from the render thread, so timing is recorded directly and the work is queued to this thread
+  QObject::connect(window, &QQuickWindow::beforeSynchronizing, this, [this]() { on_frame_start(); }, Qt::DirectConnection);
+  QObject::connect(window, &QQuickWindow::frameSwapped, this, [this]() { on_frame_swapped(); }, Qt::DirectConnection);
+
+  // Covers the work queued before the application was there, in case the window never renders a frame
+  start_idle_timer();
+}
+
+void FrameScheduler::enqueue(jl_function_t* f)
+{
+  cxx_wrap::protect_from_gc(f);
+  m_work_items.push_back(f);
+  schedule_idle();
+}
+
+void FrameScheduler::set_budget(double ms)
+{
+  m_budget_ns = std::max(qint64(0), static_cast<qint64>(ms * 1e6));
+}
+
+void FrameScheduler::get_stats(cxx_wrap::ArrayRef<double> stats) const
+{
+  if(stats.size() != NbStats)
+  {
+    throw std::runtime_error("Frame scheduler statistics need an array of size " + std::to_string(NbStats));
+  }
+
+  stats[FrameIntervalMs] = m_frame_interval_ns.load() / 1e6;
+  stats[BudgetMs] = m_budget_ns / 1e6;
+  stats[NbFrames] = m_nb_frames;
+  stats[NbItemsRun] = m_nb_items_run;
+  stats[NbDeferredFrames] = m_nb_deferred_frames;
+  stats[NbOverruns] = m_nb_overruns;
+  stats[MeanUsedMs] = m_nb_frames == 0 ? 0. : m_total_used_ns / 1e6 / m_nb_frames;
+  stats[MaxUsedMs] = m_max_used_ns / 1e6;
+  stats[LastUsedMs] = m_last_used_ns / 1e6;
+}
+
+void FrameScheduler::reset_stats()
+{
+  m_nb_frames = 0;
+  m_nb_items_run = 0;
+  m_nb_deferred_frames = 0;
+  m_nb_overruns = 0;
+  m_total_used_ns = 0;
+  m_max_used_ns = 0;
+  m_last_used_ns = 0;
+}
+
+void FrameScheduler::start_idle_timer()
+{
+  m_idle_timer.stop();
+  schedule_idle();
+}
+
+void FrameScheduler::stop_idle_timer()
+{
+  m_idle_timer.stop();
+}
+
+void FrameScheduler::on_frame_start()
+{
+  m_frame_start_ns.store(m_clock.nsecsElapsed());
+}
+
+void FrameScheduler::on_frame_swapped()
+{
+  const qint64 now = m_clock.nsecsElapsed();
+  const qint64 previous_swap = m_swap_ns.exchange(now);
+
+  // Smooth the measured frame interval, ignoring gaps where nothing was rendered
+  const qint64 interval = m_frame_interval_ns.load();
+  const qint64 measured_interval = now - previous_swap;
+  if(previous_swap != 0 && measured_interval > 0 && measured_interval < 3*interval)
+  {
+    m_frame_interval_ns.store((7*interval + measured_interval) / 8);
+  }
+
+  const qint64 frame_start = m_frame_start_ns.load();
+  if(frame_start != 0 && frame_start < now)
+  {
+    m_render_ns.store((7*m_render_ns.load() + (now - frame_start)) / 8);
+  }
+
+  if(!m_frame_work_pending.exchange(true))
+  {
+    QMetaObject::invokeMethod(this, "run_frame_work", Qt::QueuedConnection);
+  }
+}
+
+void FrameScheduler::run_frame_work()
+{
+  m_frame_work_pending.store(false);
+  if(m_work_items.empty())
+  {
+    return;
+  }
+
+  // Leave time to prepare and render the next frame
+  const qint64 next_frame_start = m_swap_ns.load() + m_frame_interval_ns.load() - m_render_ns.load();
+  const qint64 slack = next_frame_start - m_clock.nsecsElapsed();
+  const qint64 budget = std::min(m_budget_ns, slack);
+
+  ++m_nb_frames;
+  if(budget <= 0)
+  {
+    ++m_nb_deferred_frames;
+    schedule_idle();
+    return;
+  }
+
+  const qint64 used = run_work(budget);
+  m_total_used_ns += used;
+  m_max_used_ns = std::max(m_max_used_ns, used);
+  m_last_used_ns = used;
+  if(used > slack)
+  {
+    ++m_nb_overruns;
+  }
+  if(!m_work_items.empty())
+  {
+    ++m_nb_deferred_frames;
+  }
+  schedule_idle();
+}
+
+void FrameScheduler::run_idle_work()
+{
+  run_work(m_budget_ns);
+  schedule_idle();
+}
+
+qint64 FrameScheduler::run_work(qint64 budget_ns)
+{
+  const qint64 start = m_clock.nsecsElapsed();
+  // Items that return true go to the back of the queue, so all items get their turn
+  while(!m_work_items.empty() && m_clock.nsecsElapsed() - start < budget_ns)
+  {
+    jl_function_t* f = m_work_items.front();
+    m_work_items.pop_front();
+
+    jl_value_t* result = jl_call0(f);
+    ++m_nb_items_run;
+    if(jl_exception_occurred())
+    {
+      jl_show(jl_stderr_obj(), jl_exception_occurred());
+      jl_printf(jl_stderr_stream(), "\n");
+      cxx_wrap::unprotect_from_gc(f);
+      continue;
+    }
+
+    if(result == jl_true)
+    {
+      m_work_items.push_back(f);
+    }
+    else
+    {
+      cxx_wrap::unprotect_from_gc(f);
+    }
+  }
+  return m_clock.nsecsElapsed() - start;
+}
+
+void FrameScheduler::schedule_idle()
+{
+  if(m_work_items.empty())
+  {
+    m_idle_timer.stop();
+    return;
+  }
+
+  // Without an application there is no event dispatcher for the timer yet, start_idle_timer is called when there is one
+  if(QAbstractEventDispatcher::instance(thread()) == nullptr)
+  {
+    return;
+  }
+
+  // Only fires if no frame comes in for two frame intervals
+  m_idle_timer.start(std::max(1, static_cast<int>(2 * m_frame_interval_ns.load() / 1000000)));
+}
+
+} // namespace qmlwrap
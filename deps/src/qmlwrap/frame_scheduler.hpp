@@ -0,0 +1,107 @@
+#ifndef QML_FRAME_SCHEDULER_H
+#define QML_FRAME_SCHEDULER_H
+
+#include <atomic>
+#include <deque>
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QQuickWindow>
+#include <QTimer>
+
+#include <cxx_wrap.hpp>
+
+namespace qmlwrap
+{
+
+/// Runs queued Julia work items in the time left in each frame after rendering, so background work does not cause dropped frames
+class FrameScheduler : public QObject
+{
+  Q_OBJECT
+public:
+  /// Order of the values written by get_stats
+  enum StatIndex
+  {
+    FrameIntervalMs,
+    BudgetMs,
+    NbFrames,
+    NbItemsRun,
+    NbDeferredFrames,
+    NbOverruns,
+    MeanUsedMs,
+    MaxUsedMs,
+    LastUsedMs,
+    NbStats
+  };
+
+  FrameScheduler(QObject* parent = 0);
+  virtual ~FrameScheduler();
+
+  /// Follow the frames of the given window
+  void add_window(QQuickWindow* window);
+
+  /// Queue a Julia function taking no arguments. It is called again in a later frame for as long as it returns true.
+  void enqueue(jl_function_t* f);
+
+  /// Maximum time spent on work items in a single frame
+  void set_budget(double ms);
+
+  /// Write the statistics to stats, which must have NbStats elements
+  void get_stats(cxx_wrap::ArrayRef<double> stats) const;
+
+  void reset_stats();
+
+  /// Start the idle timer if there is pending work. Work can be queued before the application exists, so this is called again once it does.
+  void start_idle_timer();
+
+  /// Stop the idle timer, which must be done before the event dispatcher of the application is deleted
+  void stop_idle_timer();
+
+private slots:
+  /// Run work in the slack of the frame that was just swapped
+  void run_frame_work();
+
+  /// Run work when no frames are rendered
+  void run_idle_work();
+
+private:
+  /// Called on the render thread when a window starts a new frame
+  void on_frame_start();
+
+  /// Called on the render thread when a window swapped its buffers
+  void on_frame_swapped();
+
+  /// Run work items for at most budget_ns, returning the time used
+  qint64 run_work(qint64 budget_ns);
+
+  /// Start the idle timer if there is work left and an event dispatcher to run it
+  void schedule_idle();
+
+  std::deque<jl_function_t*> m_work_items;
+  QList<QPointer<QQuickWindow>> m_windows;
+  QElapsedTimer m_clock;
+  QTimer m_idle_timer;
+  qint64 m_budget_ns = 4000000;
+
+  // Frame timing, written from the render thread
+  std::atomic<qint64> m_frame_start_ns;
+  std::atomic<qint64> m_swap_ns;
+  std::atomic<qint64> m_frame_interval_ns;
+  std::atomic<qint64> m_render_ns;
+  std::atomic<bool> m_frame_work_pending;
+
+  // Statistics
+  qint64 m_nb_frames = 0;
+  qint64 m_nb_items_run = 0;
+  qint64 m_nb_deferred_frames = 0;
+  qint64 m_nb_overruns = 0;
+  qint64 m_total_used_ns = 0;
+  qint64 m_max_used_ns = 0;
+  qint64 m_last_used_ns = 0;
+};
+
+} // namespace qmlwrap
+
+#endif
@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include <QDebug>
+
+#include "gc_root_arena.hpp"
+
+namespace qmlwrap
+{
+
+namespace detail
+{
+  // All existing arenas, in order of creation
+  std::vector<GCRootArena*>& arenas()
+  {
+    static std::vector<GCRootArena*> arena_list;
+    return arena_list;
+  }
+}
+
+GCRootArena::GCRootArena(const QString& name, QObject* parent) : QObject(parent), m_name(name)
+{
+  setObjectName(name);
+  m_roots = jl_alloc_array_1d(jl_apply_array_type(jl_any_type, 1), 0);
+  cxx_wrap::protect_from_gc((jl_value_t*)m_roots);
+  detail::arenas().push_back(this);
+}
+
+GCRootArena::~GCRootArena()
+{
+  // Everything still in the array becomes collectable together with it
+  cxx_wrap::unprotect_from_gc((jl_value_t*)m_roots);
+  std::vector<GCRootArena*>& arena_list = detail::arenas();
+  arena_list.erase(std::remove(arena_list.begin(), arena_list.end(), this), arena_list.end());
+}
+
+GCRootArena* GCRootArena::of(QObject* owner, const QString& name)
+{
+  GCRootArena* arena = owner->findChild<GCRootArena*>(name, Qt::FindDirectChildrenOnly);
+  if(arena == nullptr)
+  {
+    arena = new GCRootArena(name, owner);
+  }
+  return arena;
+}
+
+GCRootArena::Handle GCRootArena::protect(jl_value_t* v)
+{
+  if(v == nullptr)
+  {
+    return invalid_handle;
+  }
+
+  Handle h;
+  if(m_free_slots.empty())
+  {
+    // Julia grows the array geometrically, so this is amortized constant time
+    h = static_cast<Handle>(jl_array_len(m_roots));
+    jl_array_grow_end(m_roots, 1);
+  }
+  else
+  {
+    h = m_free_slots.back();
+    m_free_slots.pop_back();
+  }
+
+  reinterpret_cast<jl_value_t**>(jl_array_data(m_roots))[h] = v;
+  jl_gc_wb(m_roots, v);
+  ++m_nb_live;
+  m_peak = std::max(m_peak, m_nb_live);
+  return h;
+}
+
+void GCRootArena::release(Handle h)
+{
+  if(h == invalid_handle)
+  {
+    return;
+  }
+
+  jl_value_t** slots = reinterpret_cast<jl_value_t**>(jl_array_data(m_roots));
+  if(h < 0 || h >= static_cast<Handle>(jl_array_len(m_roots)) || slots[h] == nullptr)
+  {
+    qWarning() << "Releasing invalid GC root handle" << h << "in arena" << m_name;
+    return;
+  }
+
+  slots[h] = nullptr;
+  m_free_slots.push_back(h);
+  --m_nb_live;
+}
+
+void GCRootArena::release_all()
+{
+  jl_array_del_end(m_roots, jl_array_len(m_roots));
+  m_free_slots.clear();
+  m_nb_live = 0;
+}
+
+void GCRootArena::report(const std::function<void(const QString&, int, int)>& f)
+{
+  for(const GCRootArena* arena : detail::arenas())
+  {
+    f(arena->name(), arena->nb_live(), arena->peak());
+  }
+}
+
+} // namespace qmlwrap
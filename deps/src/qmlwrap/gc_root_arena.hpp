@@ -0,0 +1,77 @@
+#ifndef QML_GC_ROOT_ARENA_H
+#define QML_GC_ROOT_ARENA_H
+
+#include <functional>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+
+#include <cxx_wrap.hpp>
+
+namespace qmlwrap
+{
+
+/// Keeps Julia values from being garbage collected on behalf of one owner, such as an engine or a ListModel.
+/// The values are stored in a single Julia array that is the only global root of the arena, so protecting and releasing a value is an array store,
+/// and all values that are still protected are released at once when the arena is destroyed.
+class GCRootArena : public QObject
+{
+  Q_OBJECT
+public:
+  /// Slot of a protected value in the arena
+  typedef int Handle;
+  static const Handle invalid_handle = -1;
+
+  GCRootArena(const QString& name, QObject* parent = 0);
+  virtual ~GCRootArena();
+
+  /// The arena that is a direct child of owner, created with the given name if there is none yet
+  static GCRootArena* of(QObject* owner, const QString& name);
+
+  /// Protect v until the returned handle is released. Protecting a null value returns invalid_handle.
+  Handle protect(jl_value_t* v);
+
+  /// Stop protecting the value of the given handle. Releasing invalid_handle does nothing.
+  void release(Handle h);
+
+  /// The value protected by a valid handle
+  jl_value_t* value(Handle h) const
+  {
+    return reinterpret_cast<jl_value_t**>(jl_array_data(m_roots))[h];
+  }
+
+  /// Release all values at once
+  void release_all();
+
+  const QString& name() const
+  {
+    return m_name;
+  }
+
+  /// Number of values that are currently protected
+  int nb_live() const
+  {
+    return m_nb_live;
+  }
+
+  /// Highest number of values protected at the same time
+  int peak() const
+  {
+    return m_peak;
+  }
+
+  /// Call f with the name, live count and peak count of each existing arena
+  static void report(const std::function<void(const QString&, int, int)>& f);
+
+private:
+  jl_array_t* m_roots;
+  std::vector<Handle> m_free_slots;
+  QString m_name;
+  int m_nb_live = 0;
+  int m_peak = 0;
+};
+
+} // namespace qmlwrap
+
+#endif
@@ -4,6 +4,7 @@
 #include "julia_api.hpp"
 
 #include <QOpenGLContext>
+#include <QQmlEngine>
 #include <QQuickWindow>
 
 namespace qmlwrap
@@ -40,9 +41,10 @@ GLVisualizeViewport::GLVisualizeViewport(QQuickItem *parent) : OpenGLViewport(pa
 
 GLVisualizeViewport::~GLVisualizeViewport()
 {
-  if(m_state != nullptr)
+  // If the engine is already gone, so are its roots
+  if(!m_gc_roots.isNull())
   {
-    cxx_wrap::unprotect_from_gc(m_state);
+    m_gc_roots->release(m_state_root);
   }
 }
 
@@ -51,8 +53,10 @@ void GLVisualizeViewport::componentComplete()
   OpenGLViewport::componentComplete();
   cxx_wrap::JuliaFunction sigs_ctor("initialize_signals", "GLVisualizeSupport");
   m_state = sigs_ctor();
-  cxx_wrap::protect_from_gc(m_state);
   assert(m_state != nullptr);
+  QQmlEngine* engine = qmlEngine(this);
+  m_gc_roots = GCRootArena::of(engine != nullptr ? static_cast<QObject*>(engine) : this, "engine");
+  m_state_root = m_gc_roots->protect(m_state);
 
   auto win_size_changed = [this] () { cxx_wrap::JuliaFunction("on_window_size_change", "GLVisualizeSupport")(m_state, width(), height()); };
   QObject::connect(this, &QQuickItem::widthChanged, win_size_changed);
@@ -3,6 +3,9 @@
 
 #include <cxx_wrap.hpp>
 
+#include <QPointer>
+
+#include "gc_root_arena.hpp"
 #include "opengl_viewport.hpp"
 
 namespace qmlwrap
@@ -20,6 +23,9 @@ public:
 private:
   // Julia type holding the signals and other state needed for GLVisualize. Manipulated from within Julia callbacks
   jl_value_t* m_state = nullptr;
+  // Roots of the engine that protect m_state
+  QPointer<GCRootArena> m_gc_roots;
+  GCRootArena::Handle m_state_root = GCRootArena::invalid_handle;
   virtual void setup_buffer(GLuint handle, int width, int height);
   virtual void post_render();
 };
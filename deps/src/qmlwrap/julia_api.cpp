@@ -1,11 +1,16 @@
+#include <algorithm>
 #include <sstream>
 
+#include <QDataStream>
 #include <QDebug>
 #include <QString>
+#include <QStringList>
 #include <QVariant>
 #include <QVariantList>
+#include <QVariantMap>
 
 #include "julia_api.hpp"
+#include "profiler.hpp"
 #include "type_conversion.hpp"
 
 namespace qmlwrap
@@ -13,16 +18,248 @@ namespace qmlwrap
 
 QVariant JuliaAPI::call(const QString& fname, const QVariantList& args)
 {
-  jl_function_t *func = jl_get_function(jl_current_module, fname.toStdString().c_str());
+  const int handle_id = existing_function_handle(fname);
+  if(handle_id == -1)
+  {
+    qWarning() << "Julia method " << fname << " was not found.";
+    return QVariant();
+  }
+  return callHandle(handle_id, args);
+}
+
+namespace detail
+{
+  // Argument access for the different argument containers accepted by JuliaAPI::call_julia
+  inline int nb_args(const QVariantList& args)
+  {
+    return args.size();
+  }
+
+  inline int nb_args(const QJSValue& args)
+  {
+    return args.property("length").toInt();
+  }
+
+  inline jl_value_t* convert_arg(const QVariantList& args, const int i)
+  {
+    return cxx_wrap::convert_to_julia(args.at(i));
+  }
+
+  inline jl_value_t* convert_arg(const QJSValue& args, const int i)
+  {
+    return cxx_wrap::convert_to_julia(args.property(i));
+  }
+
+  inline QString arg_description(const QVariantList& args, const int i)
+  {
+    return args.at(i).typeName();
+  }
+
+  inline QString arg_description(const QJSValue& args, const int i)
+  {
+    return args.property(i).toString();
+  }
+
+  // Value of an argument as used in the cache key of a pure function, invalid if the argument can't be part of a key
+  inline QVariant cache_key_value(const QVariantList& args, const int i)
+  {
+    return args.at(i);
+  }
+
+  inline QVariant cache_key_value(const QJSValue& args, const int i)
+  {
+    const QJSValue arg = args.property(i);
+    return arg.isQObject() || arg.isCallable() ? QVariant() : arg.toVariant();
+  }
+
+  // Append a value to a cache key, returning false if it contains anything that can't be serialized, such as an object or a pointer.
+  // Containers are written element by element, so each element is checked.
+  bool write_cache_key_value(QDataStream& stream, const QVariant& value)
+  {
+    const int type = value.userType();
+    stream << type;
+    switch(type)
+    {
+    case QMetaType::QVariantList:
+    {
+      const QVariantList list = value.toList();
+      stream << list.size();
+      for(const QVariant& element : list)
+      {
+        if(!write_cache_key_value(stream, element))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+    case QMetaType::QVariantMap:
+    {
+      const QVariantMap map = value.toMap();
+      stream << map.size();
+      for(auto it = map.constBegin(); it != map.constEnd(); ++it)
+      {
+        stream << it.key();
+        if(!write_cache_key_value(stream, it.value()))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+    case QMetaType::QVariantHash:
+    {
+      // Sorted, so equal hashes give the same key
+      const QVariantHash hash = value.toHash();
+      QStringList keys = hash.keys();
+      keys.sort();
+      stream << keys.size();
+      for(const QString& key : keys)
+      {
+        stream << key;
+        if(!write_cache_key_value(stream, hash.value(key)))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+    case QMetaType::UnknownType:
+    case QMetaType::VoidStar:
+    case QMetaType::QObjectStar:
+      return false;
+    default:
+      break;
+    }
+
+    const QMetaType::TypeFlags pointer_flags = QMetaType::PointerToQObject | QMetaType::PointerToGadget | QMetaType::SharedPointerToQObject | QMetaType::WeakPointerToQObject | QMetaType::TrackingPointerToQObject;
+    if(QMetaType::typeFlags(type) & pointer_flags)
+    {
+      return false;
+    }
+
+    // Fails for types without stream operators, which includes user types such as function pointers
+    return QMetaType::save(stream, type, value.constData());
+  }
+
+  // True if the value is an object or a container holding one at any depth. Such results are not cached, since objects may be deleted by their owner.
+  bool contains_object(const QVariant& value)
+  {
+    switch(value.userType())
+    {
+    case QMetaType::QObjectStar:
+      return true;
+    case QMetaType::QVariantList:
+      for(const QVariant& element : value.toList())
+      {
+        if(contains_object(element))
+        {
+          return true;
+        }
+      }
+      return false;
+    case QMetaType::QVariantMap:
+      for(const QVariant& element : value.toMap())
+      {
+        if(contains_object(element))
+        {
+          return true;
+        }
+      }
+      return false;
+    case QMetaType::QVariantHash:
+      for(const QVariant& element : value.toHash())
+      {
+        if(contains_object(element))
+        {
+          return true;
+        }
+      }
+      return false;
+    default:
+      return (QMetaType::typeFlags(value.userType()) & QMetaType::PointerToQObject) != 0;
+    }
+  }
+
+  // Build the key for the pure function cache, returning false if some argument can't be serialized
+  template<typename ArgsT>
+  bool pure_cache_key(const int handle_id, const ArgsT& args, QByteArray& key)
+  {
+    key = QByteArray::number(handle_id) + ':';
+    bool key_ok = true;
+    {
+      QDataStream stream(&key, QIODevice::WriteOnly | QIODevice::Append);
+      const int nb_args = detail::nb_args(args);
+      for(int i = 0; i != nb_args && key_ok; ++i)
+      {
+        key_ok = write_cache_key_value(stream, cache_key_value(args, i));
+      }
+      key_ok = key_ok && stream.status() == QDataStream::Ok;
+    }
+    if(!key_ok)
+    {
+      key.clear();
+    }
+    return key_ok;
+  }
+
+  // Error message for a Julia exception, as printed by showerror
+  QString exception_message(jl_value_t* exception)
+  {
+    jl_value_t* message = nullptr;
+    JL_GC_PUSH2(&exception, &message);
+    message = jl_call2(jl_get_function(jl_base_module, "sprint"), jl_get_function(jl_base_module, "showerror"), exception);
+    QString result = message != nullptr && cxx_wrap::is_julia_string(message) ? cxx_wrap::convert_to_cpp<QString>(message) : QString(cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(exception)).c_str());
+    JL_GC_POP();
+    return result;
+  }
+}
+
+QVariant JuliaAPI::callHandle(int handle_id, const QVariantList& args)
+{
+  return call_julia(handle_id, args);
+}
+
+QVariant JuliaAPI::invokeHandle(int handle_id, const QJSValue& args)
+{
+  return call_julia(handle_id, args);
+}
+
+template<typename ArgsT>
+QVariant JuliaAPI::call_julia(int handle_id, const ArgsT& args)
+{
+  if(handle_id < 0 || handle_id >= static_cast<int>(m_function_handles.size()))
+  {
+    qWarning() << "Invalid Julia function handle " << handle_id;
+    return QVariant();
+  }
+
+  const QString fname = m_function_handles[handle_id].name;
+  jl_function_t *func = resolve_function(handle_id);
   if(func == nullptr)
   {
     qWarning() << "Julia method " << fname << " was not found.";
     return QVariant();
   }
 
+  // Cache hits are profiled as well, so the report shows every call made from QML
+  profiler::Scope profile_scope(profiler::Category::Call, fname);
+
+  QByteArray cache_key;
+  if(m_function_handles[handle_id].pure && detail::pure_cache_key(handle_id, args, cache_key))
+  {
+    const QVariant* cached_result = m_pure_cache.object(cache_key);
+    if(cached_result != nullptr)
+    {
+      ++m_pure_cache_hits;
+      return *cached_result;
+    }
+    ++m_pure_cache_misses;
+  }
+
   QVariant result_var;
 
-  const int nb_args = args.size();
+  const int nb_args = detail::nb_args(args);
 
   jl_value_t* result = nullptr;
   jl_value_t** julia_args;
@@ -32,10 +269,10 @@ QVariant JuliaAPI::call(const QString& fname, const QVariantList& args)
   // Process arguments
   for(int i = 0; i != nb_args; ++i)
   {
-    julia_args[i] = cxx_wrap::convert_to_julia(args.at(i));
+    julia_args[i] = detail::convert_arg(args, i);
     if(julia_args[i] == nullptr)
     {
-      qWarning() << "Julia argument type for function " << fname << " is unsupported:" << args[i].typeName();
+      qWarning() << "Julia argument type for function " << fname << " is unsupported:" << detail::arg_description(args, i);
       JL_GC_POP();
       JL_GC_POP();
       return QVariant();
@@ -69,14 +306,364 @@ QVariant JuliaAPI::call(const QString& fname, const QVariantList& args)
   JL_GC_POP();
   JL_GC_POP();
 
+  if(!cache_key.isEmpty() && result_var.isValid() && !detail::contains_object(result_var))
+  {
+    m_pure_cache.insert(cache_key, new QVariant(result_var));
+  }
+
   return result_var;
 }
 
+QVariantList JuliaAPI::callBatch(const QJSValue& calls)
+{
+  const int nb_calls = detail::nb_args(calls);
+  if(nb_calls == 0)
+  {
+    return QVariantList();
+  }
+
+  // Resolve all functions and count the arguments, so everything fits in a single GC frame
+  std::vector<QString> fnames(nb_calls);
+  std::vector<jl_function_t*> functions(nb_calls, nullptr);
+  std::vector<QJSValue> call_args(nb_calls);
+  std::vector<int> arg_offsets(nb_calls+1, 0);
+  std::vector<QString> errors(nb_calls);
+  for(int i = 0; i != nb_calls; ++i)
+  {
+    const QJSValue call_spec = calls.property(i);
+    fnames[i] = call_spec.property(0).toString();
+    const int handle_id = existing_function_handle(fnames[i]);
+    functions[i] = handle_id == -1 ? nullptr : resolve_function(handle_id);
+    if(functions[i] == nullptr)
+    {
+      errors[i] = "Julia method " + fnames[i] + " was not found";
+    }
+    call_args[i] = call_spec.property(1);
+    const int nb_args = call_args[i].isUndefined() ? 0 : detail::nb_args(call_args[i]);
+    arg_offsets[i+1] = arg_offsets[i] + nb_args;
+  }
+
+  // Arguments for all calls, followed by one result per call
+  const int nb_total_args = arg_offsets[nb_calls];
+  jl_value_t** roots;
+  JL_GC_PUSHARGS(roots, nb_total_args + nb_calls);
+  jl_value_t** julia_args = roots;
+  jl_value_t** results = roots + nb_total_args;
+
+  // Convert all arguments
+  for(int i = 0; i != nb_calls; ++i)
+  {
+    if(!errors[i].isNull())
+    {
+      continue;
+    }
+    const int nb_args = arg_offsets[i+1] - arg_offsets[i];
+    for(int j = 0; j != nb_args; ++j)
+    {
+      jl_value_t*& julia_arg = julia_args[arg_offsets[i] + j];
+      julia_arg = detail::convert_arg(call_args[i], j);
+      if(julia_arg == nullptr)
+      {
+        errors[i] = "Unsupported argument type: " + detail::arg_description(call_args[i], j);
+        break;
+      }
+    }
+  }
+
+  // Do the calls
+  for(int i = 0; i != nb_calls; ++i)
+  {
+    if(!errors[i].isNull())
+    {
+      continue;
+    }
+    profiler::Scope profile_scope(profiler::Category::Call, fnames[i]);
+    results[i] = jl_call(functions[i], julia_args + arg_offsets[i], arg_offsets[i+1] - arg_offsets[i]);
+    jl_value_t* exception = jl_exception_occurred();
+    if(exception != nullptr)
+    {
+      results[i] = nullptr;
+      errors[i] = detail::exception_message(exception);
+    }
+  }
+
+  // Convert the results
+  QVariantList batch_result;
+  batch_result.reserve(nb_calls);
+  for(int i = 0; i != nb_calls; ++i)
+  {
+    QVariant value;
+    if(errors[i].isNull() && results[i] != nullptr && !jl_is_nothing(results[i]))
+    {
+      value = cxx_wrap::convert_to_cpp<QVariant>(results[i]);
+      if(value.isNull())
+      {
+        errors[i] = "Unsupported return type " + QString(cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(results[i])).c_str());
+      }
+    }
+
+    QVariantMap call_result;
+    call_result["ok"] = errors[i].isNull();
+    call_result["value"] = value;
+    call_result["error"] = errors[i].isNull() ? QString("") : errors[i];
+    batch_result.push_back(call_result);
+  }
+  JL_GC_POP();
+
+  return batch_result;
+}
+
 QVariant JuliaAPI::call(const QString& fname)
 {
   return call(fname, QVariantList());
 }
 
+int JuliaAPI::function_handle(const QString& fname)
+{
+  auto handle_it = m_function_handle_ids.constFind(fname);
+  if(handle_it != m_function_handle_ids.constEnd())
+  {
+    return handle_it.value();
+  }
+
+  const int handle_id = m_function_handles.size();
+  m_function_handles.push_back(FunctionHandle({fname, nullptr, false, false}));
+  m_function_handle_ids[fname] = handle_id;
+  return handle_id;
+}
+
+int JuliaAPI::existing_function_handle(const QString& fname)
+{
+  auto handle_it = m_function_handle_ids.constFind(fname);
+  if(handle_it != m_function_handle_ids.constEnd())
+  {
+    return handle_it.value();
+  }
+  // Handles are never removed, so calls by name must not add one for each misspelled or generated name
+  if(jl_get_function(jl_current_module, fname.toStdString().c_str()) == nullptr)
+  {
+    return -1;
+  }
+  return function_handle(fname);
+}
+
+jl_function_t* JuliaAPI::resolve_function(int handle_id)
+{
+  if(jl_current_module != m_function_module)
+  {
+    clear_function_cache();
+    m_function_module = jl_current_module;
+  }
+
+  FunctionHandle& handle = m_function_handles[handle_id];
+  if(handle.function == nullptr && !handle.not_found)
+  {
+    handle.function = jl_get_function(jl_current_module, handle.name.toStdString().c_str());
+    if(handle.function != nullptr)
+    {
+      cxx_wrap::protect_from_gc(handle.function);
+    }
+    else
+    {
+      // Looked up again after registering the function again or changing module
+      handle.not_found = true;
+    }
+  }
+  return handle.function;
+}
+
+void JuliaAPI::clear_function_cache()
+{
+  m_pure_cache.clear();
+  for(FunctionHandle& handle : m_function_handles)
+  {
+    if(handle.function != nullptr)
+    {
+      cxx_wrap::unprotect_from_gc(handle.function);
+      handle.function = nullptr;
+    }
+    handle.not_found = false;
+  }
+}
+
+int JuliaAPI::callAsync(const QString& fname, const QVariantList& args, const QJSValue& callback, const QJSValue& error_callback)
+{
+  const int handle_id = existing_function_handle(fname);
+  if(handle_id < 0)
+  {
+    // Reported like any other failure, so the error callback runs from the event loop and never before callAsync returns
+    const int call_id = m_next_async_call_id++;
+    m_running_async_calls[call_id] = AsyncCall({call_id, handle_id, args, callback, error_callback, false});
+    async_call_failed(call_id, "Julia method " + fname + " was not found");
+    return call_id;
+  }
+  return callAsyncHandle(handle_id, args, callback, error_callback);
+}
+
+int JuliaAPI::callAsyncHandle(int handle_id, const QVariantList& args, const QJSValue& callback, const QJSValue& error_callback)
+{
+  if(handle_id < 0 || handle_id >= static_cast<int>(m_function_handles.size()))
+  {
+    qWarning() << "Invalid Julia function handle " << handle_id;
+    return 0;
+  }
+
+  const int call_id = m_next_async_call_id++;
+  m_queued_async_calls.push_back(AsyncCall({call_id, handle_id, args, callback, error_callback, false}));
+  start_async_calls();
+  return call_id;
+}
+
+bool JuliaAPI::cancelAsync(int call_id)
+{
+  for(auto it = m_queued_async_calls.begin(); it != m_queued_async_calls.end(); ++it)
+  {
+    if(it->id == call_id)
+    {
+      m_queued_async_calls.erase(it);
+      return true;
+    }
+  }
+
+  auto running_it = m_running_async_calls.find(call_id);
+  if(running_it == m_running_async_calls.end())
+  {
+    return false;
+  }
+  running_it->cancelled = true;
+  return true;
+}
+
+void JuliaAPI::setMaxAsyncCalls(int max_calls)
+{
+  m_max_async_calls = std::max(1, max_calls);
+  start_async_calls();
+}
+
+void JuliaAPI::async_call_finished(int call_id, jl_value_t* result)
+{
+  QVariant result_var;
+  QString error;
+  if(result != nullptr && !jl_is_nothing(result))
+  {
+    result_var = cxx_wrap::convert_to_cpp<QVariant>(result);
+    if(result_var.isNull())
+    {
+      error = "Unsupported return type " + QString(cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(result)).c_str());
+    }
+  }
+
+  // Always go through the event loop, so the callback runs on the GUI thread and outside of the Julia task
+  QMetaObject::invokeMethod(this, "finish_async_call", Qt::QueuedConnection, Q_ARG(int, call_id), Q_ARG(QVariant, result_var), Q_ARG(QString, error));
+}
+
+void JuliaAPI::async_call_failed(int call_id, const QString& message)
+{
+  QMetaObject::invokeMethod(this, "finish_async_call", Qt::QueuedConnection, Q_ARG(int, call_id), Q_ARG(QVariant, QVariant()), Q_ARG(QString, message.isNull() ? QString("") : message));
+}
+
+bool JuliaAPI::async_call_cancelled(int call_id) const
+{
+  auto running_it = m_running_async_calls.constFind(call_id);
+  return running_it == m_running_async_calls.constEnd() || running_it->cancelled;
+}
+
+void JuliaAPI::finish_async_call(int call_id, const QVariant& result, const QString& error)
+{
+  auto running_it = m_running_async_calls.find(call_id);
+  if(running_it == m_running_async_calls.end())
+  {
+    return;
+  }
+  const AsyncCall call = running_it.value();
+  m_running_async_calls.erase(running_it);
+  // Calls of a function that was not found have no handle
+  const QString fname = call.handle_id < 0 ? QString("unknown") : m_function_handles[call.handle_id].name;
+
+  if(!call.cancelled && m_engine != nullptr)
+  {
+    QJSValue callback_result;
+    if(error.isNull())
+    {
+      if(call.callback.isCallable())
+      {
+        callback_result = call.callback.call(QJSValueList() << m_engine->toScriptValue(result));
+      }
+    }
+    else if(call.error_callback.isCallable())
+    {
+      callback_result = call.error_callback.call(QJSValueList() << QJSValue(error));
+    }
+    else
+    {
+      qWarning() << "Asynchronous call of Julia function " << fname << " failed: " << error;
+    }
+
+    if(callback_result.isError())
+    {
+      qWarning() << "Error in callback for asynchronous call of Julia function " << fname << ": " << callback_result.toString();
+    }
+  }
+
+  start_async_calls();
+}
+
+void JuliaAPI::start_async_calls()
+{
+  while(!m_queued_async_calls.empty() && m_running_async_calls.size() < m_max_async_calls)
+  {
+    AsyncCall call = m_queued_async_calls.front();
+    m_queued_async_calls.pop_front();
+
+    jl_function_t* func = resolve_function(call.handle_id);
+    if(func == nullptr)
+    {
+      m_running_async_calls[call.id] = call;
+      async_call_failed(call.id, "Julia method " + m_function_handles[call.handle_id].name + " was not found");
+      continue;
+    }
+
+    // Arguments are converted here, on the GUI thread
+    cxx_wrap::Array<jl_value_t*> julia_args;
+    JL_GC_PUSH1(julia_args.gc_pointer());
+    bool args_ok = true;
+    for(const QVariant& arg : call.args)
+    {
+      jl_value_t* julia_arg = cxx_wrap::convert_to_julia(arg);
+      if(julia_arg == nullptr)
+      {
+        args_ok = false;
+        break;
+      }
+      julia_args.push_back(julia_arg);
+    }
+
+    m_running_async_calls[call.id] = call;
+    if(!args_ok)
+    {
+      async_call_failed(call.id, "Unsupported argument type for Julia function " + m_function_handles[call.handle_id].name);
+      JL_GC_POP();
+      continue;
+    }
+
+    // Schedules a Julia task that calls back into async_call_finished or async_call_failed. This is called from QML, so errors are
+    // reported to the call instead of propagated, and the GC frame is popped on every path.
+    try
+    {
+      cxx_wrap::JuliaFunction("start_async_call", "QML")(call.id, (jl_value_t*)func, (jl_value_t*)julia_args.wrapped());
+    }
+    catch(const std::exception& e)
+    {
+      async_call_failed(call.id, "Error starting Julia function " + m_function_handles[call.handle_id].name + ": " + QString(e.what()));
+    }
+    catch(...)
+    {
+      async_call_failed(call.id, "Error starting Julia function " + m_function_handles[call.handle_id].name);
+    }
+    JL_GC_POP();
+  }
+}
+
 void JuliaAPI::setJuliaSignals(JuliaSignals* julia_signals)
 {
   m_julia_signals = julia_signals;
@@ -85,6 +672,8 @@ void JuliaAPI::setJuliaSignals(JuliaSignals* julia_signals)
 void JuliaAPI::set_js_engine(QJSEngine* e)
 {
   m_engine = e;
+  m_function_factory = QJSValue();
+  m_async_function_factory = QJSValue();
   if(m_engine != nullptr)
   {
     for(const QString& fname : m_registered_functions)
@@ -95,8 +684,19 @@ void JuliaAPI::set_js_engine(QJSEngine* e)
   }
 }
 
-void JuliaAPI::register_function(const QString& name)
+void JuliaAPI::register_function(const QString& name, bool pure)
 {
+  // Registering again means the function may have changed, so look it up again on the next call
+  FunctionHandle& handle = m_function_handles[function_handle(name)];
+  if(handle.function != nullptr)
+  {
+    cxx_wrap::unprotect_from_gc(handle.function);
+    handle.function = nullptr;
+  }
+  handle.not_found = false;
+  handle.pure = pure;
+  flush_pure_cache(name);
+
   if(m_engine == nullptr)
   {
     m_registered_functions.push_back(name);
@@ -107,6 +707,34 @@ void JuliaAPI::register_function(const QString& name)
   }
 }
 
+void JuliaAPI::flush_pure_cache()
+{
+  m_pure_cache.clear();
+}
+
+void JuliaAPI::flush_pure_cache(const QString& fname)
+{
+  auto handle_it = m_function_handle_ids.constFind(fname);
+  if(handle_it == m_function_handle_ids.constEnd())
+  {
+    return;
+  }
+
+  const QByteArray prefix = QByteArray::number(handle_it.value()) + ':';
+  for(const QByteArray& key : m_pure_cache.keys())
+  {
+    if(key.startsWith(prefix))
+    {
+      m_pure_cache.remove(key);
+    }
+  }
+}
+
+void JuliaAPI::set_pure_cache_size(int max_entries)
+{
+  m_pure_cache.setMaxCost(std::max(0, max_entries));
+}
+
 JuliaAPI* JuliaAPI::instance()
 {
   static JuliaAPI m_instance;
@@ -119,9 +747,17 @@ JuliaAPI::~JuliaAPI()
 
 void JuliaAPI::on_about_to_quit()
 {
+  // Results that arrive after this are dropped, since the JS callbacks belong to the engine
+  m_queued_async_calls.clear();
+  for(AsyncCall& call : m_running_async_calls)
+  {
+    call.cancelled = true;
+  }
   m_engine = nullptr;
   m_julia_signals = nullptr;
   m_julia_js_root = QJSValue();
+  m_function_factory = QJSValue();
+  m_async_function_factory = QJSValue();
 }
 
 void JuliaAPI::register_function_internal(const QString& fname)
@@ -131,23 +767,47 @@ void JuliaAPI::register_function_internal(const QString& fname)
     throw std::runtime_error("No JS engine, can't register function");
   }
 
-  QJSValue f = m_engine->evaluate("function() { return Qt.julia.call(\"" + fname + "\", arguments.length === 1 ? [arguments[0]] : Array.apply(null, arguments)); }");
+  // Script code is compiled once per engine, each function only binds its handle
+  if(m_function_factory.isUndefined())
+  {
+    // The arguments object is passed on as-is and converted directly to Julia values, without an intermediate array or QVariantList
+    m_function_factory = m_engine->evaluate("(function(handle_id) { return function() { return Qt.julia.invokeHandle(handle_id, arguments); }; })");
+    // Asynchronous variant, taking the result and error callbacks as last arguments
+    m_async_function_factory = m_engine->evaluate("(function(handle_id) { return function() { var args = Array.prototype.slice.call(arguments); var callbacks = []; while(args.length > 0 && callbacks.length < 2 && typeof args[args.length-1] === 'function') { callbacks.unshift(args.pop()); } return Qt.julia.callAsyncHandle(handle_id, args, callbacks[0], callbacks[1]); }; })");
+    if(!m_function_factory.isCallable() || !m_async_function_factory.isCallable())
+    {
+      m_function_factory = QJSValue();
+      m_async_function_factory = QJSValue();
+      throw std::runtime_error("Error creating the QML function wrappers");
+    }
+  }
 
+  const QJSValueList handle_arg = QJSValueList() << QJSValue(function_handle(fname));
+  QJSValue f = m_function_factory.call(handle_arg);
   if(f.isError() || !f.isCallable())
   {
     throw std::runtime_error(("Error setting function" + fname).toStdString());
   }
 
   m_julia_js_root.setProperty(fname,f);
+
+  QJSValue async_f = m_async_function_factory.call(handle_arg);
+  if(async_f.isError() || !async_f.isCallable())
+  {
+    throw std::runtime_error(("Error setting async function" + fname).toStdString());
+  }
+
+  m_julia_js_root.property("async").setProperty(fname, async_f);
 }
 
-JuliaAPI::JuliaAPI()
+JuliaAPI::JuliaAPI() : m_pure_cache(1024)
 {
 }
 
 QJSValue julia_js_singletontype_provider(QQmlEngine *engine, QJSEngine *scriptEngine)
 {
   QJSValue result = scriptEngine->newObject();
+  result.setProperty("async", scriptEngine->newObject());
   JuliaAPI* api = JuliaAPI::instance();
   api->set_julia_js_root(result);
   api->set_js_engine(engine);
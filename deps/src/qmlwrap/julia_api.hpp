@@ -1,13 +1,19 @@
 #ifndef QML_JULIA_API_H
 #define QML_JULIA_API_H
 
+#include <deque>
 #include <vector>
 
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
 #include <QJSValue>
 #include <QObject>
 #include <QQmlEngine>
 #include <QVariant>
 
+#include <cxx_wrap.hpp>
+
 namespace qmlwrap
 {
 
@@ -17,6 +23,7 @@ class JuliaSignals;
 class JuliaAPI : public QObject
 {
   Q_OBJECT
+  Q_PROPERTY(int maxAsyncCalls READ maxAsyncCalls WRITE setMaxAsyncCalls)
 public:
 
   // Call a Julia function that takes any number of arguments as a list
@@ -25,6 +32,48 @@ public:
   // Call a Julia function that takes no arguments
   Q_INVOKABLE QVariant call(const QString& fname);
 
+  // Call several Julia functions at once. calls is an array of [fname, args] pairs, the result is an array with for each call an object with properties ok, value and error.
+  Q_INVOKABLE QVariantList callBatch(const QJSValue& calls);
+
+  // Call a Julia function using a handle obtained from function_handle
+  Q_INVOKABLE QVariant callHandle(int handle_id, const QVariantList& args);
+
+  // Call a Julia function using a handle, converting the elements of a JS array or arguments object directly to Julia
+  Q_INVOKABLE QVariant invokeHandle(int handle_id, const QJSValue& args);
+
+  /// Get the handle id for the function with the given name. The function itself is only looked up when it is first called.
+  int function_handle(const QString& fname);
+
+  /// Get the handle id for a function called by name, without adding a handle if no such function exists. Returns -1 in that case.
+  int existing_function_handle(const QString& fname);
+
+  // Call a Julia function asynchronously, in a Julia task. callback receives the result and error_callback the error message in case of failure, also when there is no such function.
+  // Returns an id for cancelAsync. The task runs on the GUI thread, so a function that computes without yielding still blocks the GUI.
+  Q_INVOKABLE int callAsync(const QString& fname, const QVariantList& args, const QJSValue& callback = QJSValue(), const QJSValue& error_callback = QJSValue());
+
+  // Asynchronous call using a function handle
+  Q_INVOKABLE int callAsyncHandle(int handle_id, const QVariantList& args, const QJSValue& callback = QJSValue(), const QJSValue& error_callback = QJSValue());
+
+  // Cancel an asynchronous call. A call that did not start yet is never started, a running call has its result discarded. Returns false if the call was already finished.
+  Q_INVOKABLE bool cancelAsync(int call_id);
+
+  // Maximum number of asynchronous calls running at the same time, other calls wait in a queue
+  int maxAsyncCalls() const
+  {
+    return m_max_async_calls;
+  }
+
+  void setMaxAsyncCalls(int max_calls);
+
+  /// Called from Julia when an asynchronous call finishes
+  void async_call_finished(int call_id, jl_value_t* result);
+
+  /// Called from Julia when an asynchronous call throws
+  void async_call_failed(int call_id, const QString& message);
+
+  /// True if the given call was cancelled
+  bool async_call_cancelled(int call_id) const;
+
   JuliaSignals* juliaSignals() const
   {
     return m_julia_signals;
@@ -33,12 +82,38 @@ public:
   void setJuliaSignals(JuliaSignals* julia_signals);
 
   void set_js_engine(QJSEngine* e);
+  QJSEngine* js_engine() const
+  {
+    return m_engine;
+  }
   void set_julia_js_root(QJSValue root)
   {
     m_julia_js_root = root;
   }
 
-  void register_function(const QString& name);
+  /// Make the function with the given name callable from QML. The results of a pure function are cached, keyed on the argument values.
+  void register_function(const QString& name, bool pure = false);
+
+  /// Forget all cached results of pure functions
+  void flush_pure_cache();
+
+  /// Forget the cached results of the given function
+  void flush_pure_cache(const QString& fname);
+
+  /// Maximum number of cached results, over all pure functions
+  void set_pure_cache_size(int max_entries);
+
+  /// Number of pure function calls answered from the cache
+  int64_t pure_cache_hits() const
+  {
+    return m_pure_cache_hits;
+  }
+
+  /// Number of pure function calls that had to call Julia
+  int64_t pure_cache_misses() const
+  {
+    return m_pure_cache_misses;
+  }
 
   static JuliaAPI* instance();
 
@@ -47,14 +122,66 @@ public:
 public slots:
   void on_about_to_quit();
 
+private slots:
+  /// Deliver the result of an asynchronous call to its callback, on the GUI thread. A non-null error indicates failure.
+  void finish_async_call(int call_id, const QVariant& result, const QString& error);
+
 private:
+  /// Asynchronous call, waiting in the queue or running
+  struct AsyncCall
+  {
+    int id;
+    int handle_id;
+    QVariantList args;
+    QJSValue callback;
+    QJSValue error_callback;
+    bool cancelled;
+  };
+
+  /// Start queued asynchronous calls, up to the maximum number of running calls
+  void start_async_calls();
+
+  /// Julia function, looked up by name the first time it is called
+  struct FunctionHandle
+  {
+    QString name;
+    jl_function_t* function;
+    bool pure;
+    bool not_found; // the last lookup failed
+  };
+
+  /// Implementation of the synchronous calls, for any argument container supported in detail::convert_arg
+  template<typename ArgsT>
+  QVariant call_julia(int handle_id, const ArgsT& args);
+
+  /// Get the function for the given handle, or nullptr if it does not exist in Julia
+  jl_function_t* resolve_function(int handle_id);
+
+  /// Forget all looked up functions
+  void clear_function_cache();
+
   JuliaSignals* m_julia_signals = nullptr;
   void register_function_internal(const QString& fname);
   QJSEngine* m_engine = nullptr;
   // This is the root js object, accessible as Julia in QML
   QJSValue m_julia_js_root;
+  // Script functions that create the QML function for a handle, compiled once per engine
+  QJSValue m_function_factory;
+  QJSValue m_async_function_factory;
   JuliaAPI();
   std::vector<QString> m_registered_functions;
+  std::vector<FunctionHandle> m_function_handles;
+  QHash<QString, int> m_function_handle_ids;
+  std::deque<AsyncCall> m_queued_async_calls;
+  QHash<int, AsyncCall> m_running_async_calls;
+  int m_next_async_call_id = 1;
+  int m_max_async_calls = 4;
+  // Module in which the cached functions were looked up
+  jl_module_t* m_function_module = nullptr;
+  // Results of pure functions, keyed on the handle id and the serialized arguments
+  QCache<QByteArray, QVariant> m_pure_cache;
+  int64_t m_pure_cache_hits = 0;
+  int64_t m_pure_cache_misses = 0;
 };
 
 QJSValue julia_js_singletontype_provider(QQmlEngine *engine, QJSEngine *scriptEngine);
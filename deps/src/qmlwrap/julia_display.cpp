@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include <QDebug>
 #include <QPainter>
 
@@ -11,16 +13,16 @@ JuliaDisplay::JuliaDisplay(QQuickItem *parent) : QQuickPaintedItem(parent)
 
 void JuliaDisplay::paint(QPainter *painter)
 {
-  painter->drawPixmap(0,0,m_pixmap);
+  painter->drawImage(0,0,m_image);
 }
 
 void JuliaDisplay::load_png(cxx_wrap::ArrayRef<unsigned char> data)
 {
-  if(m_pixmap.isNull())
+  if(m_image.isNull())
   {
     clear();
   }
-  if(!m_pixmap.loadFromData(data.data(), data.size(), "PNG"))
+  if(!m_image.loadFromData(data.data(), data.size(), "PNG"))
   {
     qWarning() << "Failed to load PNG data";
     clear();
@@ -28,10 +30,74 @@ void JuliaDisplay::load_png(cxx_wrap::ArrayRef<unsigned char> data)
   update();
 }
 
+void JuliaDisplay::load_rgba(cxx_wrap::ArrayRef<uint32_t> data, int width, int height)
+{
+  load_pixels(data.data(), data.size(), width, height, 4, QImage::Format_ARGB32);
+}
+
+void JuliaDisplay::load_rgb24(cxx_wrap::ArrayRef<uint32_t> data, int width, int height)
+{
+  load_pixels(data.data(), data.size(), width, height, 4, QImage::Format_RGB32);
+}
+
+void JuliaDisplay::load_gray(cxx_wrap::ArrayRef<unsigned char> data, int width, int height)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 5, 0))
+  load_pixels(data.data(), data.size(), width, height, 1, QImage::Format_Grayscale8);
+#else
+  load_pixels(data.data(), data.size(), width, height, 1, QImage::Format_Indexed8);
+  QVector<QRgb> gray_table(256);
+  for(int i = 0; i != 256; ++i)
+  {
+    gray_table[i] = qRgb(i, i, i);
+  }
+  m_image.setColorTable(gray_table);
+#endif
+}
+
+void JuliaDisplay::load_pixels(const void* data, std::size_t data_size, int width, int height, int bytes_per_pixel, QImage::Format format)
+{
+  if(width < 0 || height < 0 || data_size != static_cast<std::size_t>(width) * height)
+  {
+    throw std::runtime_error("Pixel data size does not match the image size");
+  }
+
+  // Only keep the pixels if the image has the same size and format, otherwise allocate a new one
+  if(m_image.width() != width || m_image.height() != height || m_image.format() != format)
+  {
+    m_image = QImage(width, height, format);
+  }
+
+  // QImage lines are aligned to 4 bytes, so gray images with a width that is not a multiple of 4 are copied line by line
+  const int line_size = width * bytes_per_pixel;
+  const uchar* src = static_cast<const uchar*>(data);
+  if(m_image.bytesPerLine() == line_size)
+  {
+    std::memcpy(m_image.bits(), src, static_cast<std::size_t>(line_size) * height);
+  }
+  else
+  {
+    for(int y = 0; y != height; ++y)
+    {
+      std::memcpy(m_image.scanLine(y), src + static_cast<std::size_t>(y) * line_size, line_size);
+    }
+  }
+  update();
+}
+
+uint32_t JuliaDisplay::pixel(int x, int y) const
+{
+  if(!m_image.valid(x, y))
+  {
+    throw std::runtime_error("Pixel coordinates out of the display image");
+  }
+  return m_image.pixel(x, y);
+}
+
 void JuliaDisplay::clear()
 {
-  m_pixmap = QPixmap(width(), height());
-  m_pixmap.fill(Qt::transparent);
+  m_image = QImage(width(), height(), QImage::Format_ARGB32_Premultiplied);
+  m_image.fill(Qt::transparent);
 }
 
 } // namespace qmlwrap
@@ -3,8 +3,8 @@
 
 #include <cxx_wrap.hpp>
 
+#include <QImage>
 #include <QObject>
-#include <QPixmap>
 #include <QQuickPaintedItem>
 
 namespace qmlwrap
@@ -22,10 +22,25 @@ public:
 
   void load_png(cxx_wrap::ArrayRef<unsigned char> data);
 
+  // Show raw pixels, stored row by row starting at the top. The data is copied once, without any encoding.
+
+  /// Non-premultiplied 0xAARRGGBB pixels
+  void load_rgba(cxx_wrap::ArrayRef<uint32_t> data, int width, int height);
+  /// 0xffRRGGBB pixels, the alpha byte is ignored
+  void load_rgb24(cxx_wrap::ArrayRef<uint32_t> data, int width, int height);
+  /// One byte per pixel
+  void load_gray(cxx_wrap::ArrayRef<unsigned char> data, int width, int height);
+
   void clear();
 
+  /// Pixel of the shown image as a non-premultiplied 0xAARRGGBB value, with x and y starting at 0 from the top left
+  uint32_t pixel(int x, int y) const;
+
 private:
-  QPixmap m_pixmap;
+  /// Copy the pixels into m_image and schedule a repaint
+  void load_pixels(const void* data, std::size_t data_size, int width, int height, int bytes_per_pixel, QImage::Format format);
+
+  QImage m_image;
 };
 
 } // namespace qmlwrap
@@ -1,71 +1,671 @@
+#include <cstring>
+#include <vector>
+
 #include <QDebug>
+#include <QHash>
+#include <QQmlEngine>
+
+#include <QtCore/private/qmetaobjectbuilder_p.h>
+#include <QtCore/private/qobject_p.h>
+
 #include "julia_object.hpp"
+#include "profiler.hpp"
 
 namespace qmlwrap
 {
 
-JuliaObject::JuliaObject(jl_value_t* julia_object, QObject* parent) : QQmlPropertyMap(this, parent), m_julia_object(julia_object)
+namespace detail
 {
-  jl_datatype_t* dt = (jl_datatype_t*)jl_typeof(julia_object);
-  if(jl_is_structtype(dt))
+
+/// Meta object for all JuliaObjects wrapping the same Julia type, with a property and a change signal per field.
+/// It is installed as the dynamic meta object of each JuliaObject, so QML property access ends up in metaCall.
+/// Fields of a basic bits type get a property of the matching C++ type that reads the field directly, other fields are QVariant properties that are converted on first read.
+class JuliaTypeMetaObject : public QAbstractDynamicMetaObject
+{
+public:
+  enum class FieldKind
+  {
+    Variant, // any other type, converted and cached by the JuliaObject
+    String,  // String, converted on each read
+    Inline   // bits type stored in the object, read directly
+  };
+
+  struct Field
   {
-    const uint32_t nb_fields = jl_datatype_nfields(dt);
-    for(uint32_t i = 0; i != nb_fields; ++i)
+    FieldKind kind;
+    int type_id;        // QMetaType of the property
+    std::size_t offset; // offset in the Julia object
+    std::size_t size;   // size in the Julia object, the size of a pointer if the field is not inline
+    bool is_pointer;
+  };
+
+  /// Get the meta object for the given type, building it the first time
+  static JuliaTypeMetaObject* get(jl_datatype_t* dt)
+  {
+    static QHash<jl_datatype_t*, JuliaTypeMetaObject*> meta_objects;
+    JuliaTypeMetaObject*& result = meta_objects[dt];
+    if(result == nullptr)
     {
-      const std::string fname = cxx_wrap::symbol_name(jl_field_name(dt, i));
-      jl_value_t* field_val = jl_fieldref(julia_object, i);
-      QVariant qt_fd = cxx_wrap::convert_to_cpp<QVariant>(field_val);
-      if(!qt_fd.isNull())
+      // Kept forever, so the type must not be collected and its address reused
+      cxx_wrap::protect_from_gc((jl_value_t*)dt);
+      result = new JuliaTypeMetaObject(dt);
+    }
+    return result;
+  }
+
+  int nb_fields() const
+  {
+    return m_fields.size();
+  }
+
+  const Field& field(int index) const
+  {
+    return m_fields[index];
+  }
+
+  /// Index of the field with the given name, or -1
+  int field_index(const QString& name) const
+  {
+    return m_field_indices.value(name, -1);
+  }
+
+  const char* field_name(int index) const
+  {
+    return property(propertyOffset() + index).name();
+  }
+
+  /// Emit the change signal of a field
+  void notify(JuliaObject* obj, int index)
+  {
+    QMetaObject::activate(obj, this, index, nullptr);
+  }
+
+  virtual int metaCall(QObject* o, QMetaObject::Call call, int id, void** args)
+  {
+    JuliaObject* obj = static_cast<JuliaObject*>(o);
+    if(id >= propertyOffset() && (call == QMetaObject::ReadProperty || call == QMetaObject::WriteProperty))
+    {
+      const int index = id - propertyOffset();
+      const Field& f = m_fields[index];
+      if(call == QMetaObject::ReadProperty)
       {
-        m_field_mapping[fname] = i;
-        insert(fname.c_str(), qt_fd);
+        switch(f.kind)
+        {
+        case FieldKind::Inline:
+          std::memcpy(args[0], static_cast<char*>(jl_data_ptr(obj->m_julia_object)) + f.offset, f.size);
+          break;
+        case FieldKind::String:
+          *reinterpret_cast<QString*>(args[0]) = cxx_wrap::convert_to_cpp<QString>(jl_fieldref(obj->m_julia_object, index));
+          break;
+        case FieldKind::Variant:
+          *reinterpret_cast<QVariant*>(args[0]) = obj->read_field(index);
+          break;
+        }
       }
-      else if(jl_is_structtype(jl_typeof(field_val)))
+      else
       {
-        insert(fname.c_str(), QVariant::fromValue(new JuliaObject(field_val, this)));
-        m_field_mapping[fname] = i;
+        switch(f.kind)
+        {
+        case FieldKind::Inline:
+          obj->write_inline_field(index, args[0]);
+          break;
+        case FieldKind::String:
+          obj->write_julia_field(index, to_julia(f, args[0]));
+          break;
+        case FieldKind::Variant:
+          obj->write_field(index, *reinterpret_cast<QVariant*>(args[0]));
+          break;
+        }
+      }
+      return -1;
+    }
+    if(id >= methodOffset() && call == QMetaObject::InvokeMetaMethod)
+    {
+      notify(obj, id - methodOffset());
+      return -1;
+    }
+    return obj->qt_metacall(call, id, args);
+  }
+
+  /// Shared between objects, so it outlives them
+  virtual void objectDestroyed(QObject*)
+  {
+  }
+
+  /// Convert a value of the C++ type of a String field. Inline fields are copied without boxing.
+  static jl_value_t* to_julia(const Field& f, const void* data)
+  {
+    if(f.type_id == QMetaType::QString)
+    {
+      return cxx_wrap::convert_to_julia(*static_cast<const QString*>(data));
+    }
+    throw std::runtime_error("Unsupported JuliaObject field type");
+  }
+
+private:
+  /// QMetaType for a bits type that can be read directly, or -1
+  static int inline_type_id(jl_value_t* t)
+  {
+    if(t == (jl_value_t*)jl_bool_type) return QMetaType::Bool;
+    if(t == (jl_value_t*)jl_int32_type) return QMetaType::Int;
+    if(t == (jl_value_t*)jl_uint32_type) return QMetaType::UInt;
+    if(t == (jl_value_t*)jl_int64_type) return QMetaType::LongLong;
+    if(t == (jl_value_t*)jl_uint64_type) return QMetaType::ULongLong;
+    if(t == (jl_value_t*)jl_float32_type) return QMetaType::Float;
+    if(t == (jl_value_t*)jl_float64_type) return QMetaType::Double;
+    return -1;
+  }
+
+  JuliaTypeMetaObject(jl_datatype_t* dt)
+  {
+    const int nb_fields = jl_datatype_nfields(dt);
+    m_fields.reserve(nb_fields);
+    for(int i = 0; i != nb_fields; ++i)
+    {
+      jl_value_t* ftype = jl_field_type(dt, i);
+      const bool is_pointer = jl_field_isptr(dt, i);
+      const int inline_id = is_pointer ? -1 : inline_type_id(ftype);
+      const std::size_t offset = jl_field_offset(dt, i);
+      const std::size_t size = is_pointer ? sizeof(jl_value_t*) : jl_field_size(dt, i);
+      if(inline_id != -1)
+      {
+        m_fields.push_back({FieldKind::Inline, inline_id, offset, size, is_pointer});
+      }
+      else if(ftype == (jl_value_t*)jl_string_type)
+      {
+        m_fields.push_back({FieldKind::String, QMetaType::QString, offset, size, is_pointer});
       }
       else
       {
-        qWarning() << "not converting unsupported field " << fname.c_str() << " of type " << cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(field_val)).c_str();
+        m_fields.push_back({FieldKind::Variant, QMetaType::QVariant, offset, size, is_pointer});
       }
     }
+
+    QMetaObjectBuilder builder;
+    builder.setClassName(("JuliaObject_" + cxx_wrap::julia_type_name(dt)).c_str());
+    builder.setSuperClass(&JuliaObject::staticMetaObject);
+    // Without this, the QML property cache calls the moc generated qt_metacall directly, which knows nothing about the fields
+    builder.setFlags(QMetaObjectBuilder::DynamicMetaObject);
+    // Signals come first, so field i has signal i and property i
+    for(int i = 0; i != nb_fields; ++i)
+    {
+      const QByteArray fname(cxx_wrap::symbol_name(jl_field_name(dt, i)).c_str());
+      builder.addSignal(fname + "Changed()");
+      m_field_indices[QString::fromUtf8(fname)] = i;
+    }
+    for(int i = 0; i != nb_fields; ++i)
+    {
+      const QByteArray fname(cxx_wrap::symbol_name(jl_field_name(dt, i)).c_str());
+      QMetaPropertyBuilder prop = builder.addProperty(fname, QMetaType::typeName(m_fields[i].type_id), i);
+      prop.setReadable(true);
+      prop.setWritable(true);
+    }
+    // The string and data tables live in the block allocated by the builder, which is never freed
+    QMetaObject* built = builder.toMetaObject();
+    *static_cast<QMetaObject*>(this) = *built;
+  }
+
+  std::vector<Field> m_fields;
+  QHash<QString, int> m_field_indices;
+};
+
+/// Roots of the wrapped Julia objects. A wrapper is shared by all its owners and can outlive each of them, so the wrappers have an arena of their own.
+GCRootArena* wrapper_roots()
+{
+  static GCRootArena* arena = new GCRootArena("JuliaObject");
+  return arena;
+}
+
+/// Convert a value assigned from QML to the declared type of a field, or return nullptr if it can't be converted.
+/// Storing a value of another type would break the type of the object, and for an inline field write the wrong number of bytes.
+jl_value_t* to_field_type(jl_datatype_t* dt, const int index, jl_value_t* val)
+{
+  jl_value_t* ftype = jl_field_type(dt, index);
+  if(val == nullptr || jl_isa(val, ftype))
+  {
+    return val;
+  }
+
+  jl_value_t* result = nullptr;
+  JL_GC_PUSH2(&val, &result);
+  result = jl_call2(jl_get_function(jl_base_module, "convert"), ftype, val);
+  if(result != nullptr && !jl_isa(result, ftype))
+  {
+    result = nullptr;
+  }
+  JL_GC_POP();
+  return result;
+}
+
+/// The wrapper of each wrapped Julia object. Wrappers keep their Julia object from being collected, and remove themselves when they are deleted.
+QHash<jl_value_t*, JuliaObject*>& wrappers()
+{
+  static QHash<jl_value_t*, JuliaObject*> wrapper_map;
+  return wrapper_map;
+}
+
+} // namespace detail
+
+JuliaObject* JuliaObject::wrap(jl_value_t* julia_object, QObject* owner)
+{
+  JuliaObject*& wrapper = detail::wrappers()[julia_object];
+  if(wrapper == nullptr)
+  {
+    wrapper = new JuliaObject(julia_object);
+    // Owners decide when the wrapper is deleted, not the JavaScript garbage collector
+    QQmlEngine::setObjectOwnership(wrapper, QQmlEngine::CppOwnership);
+  }
+  wrapper->add_owner(owner);
+  return wrapper;
+}
+
+void JuliaObject::add_owner(QObject* owner)
+{
+  // An object that contains itself must not keep its own wrapper alive
+  if(owner == nullptr || owner == this)
+  {
+    return;
+  }
+  auto owner_it = m_owners.find(owner);
+  if(owner_it != m_owners.end())
+  {
+    ++owner_it->nb_references;
+    return;
+  }
+  m_owners[owner] = Owner{QObject::connect(owner, &QObject::destroyed, this, [this, owner]() { remove_owner(owner, false); }), 1};
+}
+
+void JuliaObject::release(QObject* owner)
+{
+  auto owner_it = m_owners.find(owner);
+  if(owner_it == m_owners.end())
+  {
+    return;
+  }
+  if(--owner_it->nb_references == 0)
+  {
+    remove_owner(owner, true);
+  }
+}
+
+void JuliaObject::release_to_javascript(QObject* owner, QJSEngine* engine)
+{
+  auto owner_it = m_owners.find(owner);
+  if(owner_it == m_owners.end())
+  {
+    return;
+  }
+  if(engine == nullptr || m_owners.size() != 1 || owner_it->nb_references != 1)
+  {
+    release(owner);
+    return;
+  }
+
+  forget_owners();
+  // Creating the JavaScript wrapper makes sure the collector sees the object, even if no handler received it
+  QQmlEngine::setObjectOwnership(this, QQmlEngine::JavaScriptOwnership);
+  engine->newQObject(this);
+}
+
+void JuliaObject::remove_owner(QObject* owner, bool delete_later)
+{
+  auto owner_it = m_owners.find(owner);
+  if(owner_it == m_owners.end())
+  {
+    return;
+  }
+  QObject::disconnect(owner_it->destroyed_connection);
+  m_owners.erase(owner_it);
+  delete_if_unused(delete_later);
+}
+
+void JuliaObject::delete_if_unused(bool delete_later)
+{
+  if(m_owners.isEmpty())
+  {
+    discard(delete_later);
+    return;
+  }
+
+  QSet<JuliaObject*> visited;
+  if(used_from_outside(visited))
+  {
+    return;
+  }
+  // Wrappers that only own each other, e.g. A.b == B and B.a == A. All of them forget their owners first, so deleting one does not make the others check again.
+  for(JuliaObject* unused : visited)
+  {
+    unused->forget_owners();
+  }
+  for(JuliaObject* unused : visited)
+  {
+    unused->discard(delete_later);
+  }
+}
+
+bool JuliaObject::used_from_outside(QSet<JuliaObject*>& visited)
+{
+  if(visited.contains(this))
+  {
+    return false;
+  }
+  visited.insert(this);
+  for(auto owner_it = m_owners.begin(); owner_it != m_owners.end(); ++owner_it)
+  {
+    JuliaObject* owner_wrapper = qobject_cast<JuliaObject*>(owner_it.key());
+    if(owner_wrapper == nullptr || owner_wrapper->used_from_outside(visited))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void JuliaObject::forget_owners()
+{
+  for(const Owner& owner : m_owners)
+  {
+    QObject::disconnect(owner.destroyed_connection);
+  }
+  m_owners.clear();
+
+  // Wrapping the same object again before the deferred delete must give a new wrapper
+  if(detail::wrappers().value(m_julia_object) == this)
+  {
+    detail::wrappers().remove(m_julia_object);
+  }
+}
+
+void JuliaObject::discard(bool delete_later)
+{
+  forget_owners();
+  if(delete_later)
+  {
+    deleteLater();
   }
   else
+  {
+    delete this;
+  }
+}
+
+JuliaObject::JuliaObject(jl_value_t* julia_object) : m_julia_object(julia_object), m_meta_object(nullptr)
+{
+  jl_datatype_t* dt = (jl_datatype_t*)jl_typeof(julia_object);
+  if(!jl_is_structtype(dt))
   {
     qWarning() << "Can't wrap a non-composite type in a JuliaObject";
+    return;
   }
 
-  QObject::connect(this, &JuliaObject::valueChanged, this, &JuliaObject::onValueChanged);
+  // Fields are read later, so the object must stay alive
+  m_julia_object_root = detail::wrapper_roots()->protect(m_julia_object);
+  m_meta_object = detail::JuliaTypeMetaObject::get(dt);
+  m_values.resize(m_meta_object->nb_fields());
+  m_converted.resize(m_meta_object->nb_fields(), false);
+  m_snapshot = QByteArray(static_cast<const char*>(jl_data_ptr(m_julia_object)), jl_datatype_size(dt));
+  m_snapshot_roots.resize(m_meta_object->nb_fields(), GCRootArena::invalid_handle);
+  for(int i = 0; i != m_meta_object->nb_fields(); ++i)
+  {
+    snapshot_field(i);
+  }
+  QObjectPrivate::get(this)->metaObject = m_meta_object;
 }
 
 JuliaObject::~JuliaObject()
 {
+  if(detail::wrappers().value(m_julia_object) == this)
+  {
+    detail::wrappers().remove(m_julia_object);
+  }
+  for(const GCRootArena::Handle h : m_snapshot_roots)
+  {
+    detail::wrapper_roots()->release(h);
+  }
+  detail::wrapper_roots()->release(m_julia_object_root);
 }
 
-void JuliaObject::onValueChanged(const QString &key, const QVariant &value)
+QVariant JuliaObject::read_field(int index)
 {
-  const auto map_it = m_field_mapping.find(key.toStdString());
-  if(map_it == m_field_mapping.end())
+  typedef detail::JuliaTypeMetaObject::FieldKind FieldKind;
+  const detail::JuliaTypeMetaObject::Field& f = m_meta_object->field(index);
+  if(f.kind == FieldKind::Inline)
   {
-    qWarning() << "value change on unmapped field: " << key << ": " << value;
+    return QVariant(f.type_id, static_cast<char*>(jl_data_ptr(m_julia_object)) + f.offset);
+  }
+  if(f.kind == FieldKind::String)
+  {
+    return QVariant(cxx_wrap::convert_to_cpp<QString>(jl_fieldref(m_julia_object, index)));
+  }
+
+  if(m_converted[index])
+  {
+    return m_values[index];
+  }
+  m_converted[index] = true;
+
+  jl_value_t* field_val = jl_fieldref(m_julia_object, index);
+  JL_GC_PUSH1(&field_val);
+  QVariant qt_fd = cxx_wrap::convert_to_cpp<QVariant>(field_val);
+  if(qt_fd.isNull())
+  {
+    if(jl_is_structtype(jl_typeof(field_val)))
+    {
+      qt_fd = QVariant::fromValue(static_cast<QObject*>(JuliaObject::wrap(field_val, this)));
+    }
+    else
+    {
+      qWarning() << "not converting unsupported field " << m_meta_object->field_name(index) << " of type " << cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(field_val)).c_str();
+    }
+  }
+  JL_GC_POP();
+
+  m_values[index] = qt_fd;
+  return qt_fd;
+}
+
+void JuliaObject::write_field(int index, const QVariant& value)
+{
+  const detail::JuliaTypeMetaObject::Field& f = m_meta_object->field(index);
+  if(f.kind != detail::JuliaTypeMetaObject::FieldKind::Variant)
+  {
+    // Typed fields keep the Julia type of the field, whatever the type of the given value
+    QVariant typed_value = value;
+    if(!typed_value.convert(f.type_id))
+    {
+      qWarning() << "Can't convert" << value << "for field" << m_meta_object->field_name(index) << "of type" << QMetaType::typeName(f.type_id);
+      return;
+    }
+    if(f.kind == detail::JuliaTypeMetaObject::FieldKind::Inline)
+    {
+      write_inline_field(index, typed_value.constData());
+    }
+    else
+    {
+      write_julia_field(index, detail::JuliaTypeMetaObject::to_julia(f, typed_value.constData()));
+    }
     return;
   }
-  jl_value_t* val = cxx_wrap::convert_to_julia(value);
+
+  jl_datatype_t* dt = (jl_datatype_t*)jl_typeof(m_julia_object);
+  jl_value_t* assigned_value = cxx_wrap::convert_to_julia(value);
+  jl_value_t* julia_value = nullptr;
+  JL_GC_PUSH2(&assigned_value, &julia_value);
+  julia_value = detail::to_field_type(dt, index, assigned_value);
+  if(julia_value == nullptr)
+  {
+    qWarning() << "Can't convert" << value << "for field" << m_meta_object->field_name(index) << "of type" << cxx_wrap::julia_type_name((jl_datatype_t*)jl_field_type(dt, index)).c_str();
+    JL_GC_POP();
+    return;
+  }
+
+  // A value that had to be converted is converted back on the next read, so QML sees what the field holds
+  const bool keep_value = julia_value == assigned_value;
+
+  // A wrapper assigned from QML is referenced like a converted field, taking the new reference first in case it is the same wrapper
+  JuliaObject* new_child = keep_value && value.userType() == QMetaType::QObjectStar ? qobject_cast<JuliaObject*>(value.value<QObject*>()) : nullptr;
+  if(new_child != nullptr)
+  {
+    new_child->add_owner(this);
+  }
+  release_child(index);
+  m_values[index] = keep_value ? value : QVariant();
+  m_converted[index] = keep_value;
+  write_julia_field(index, julia_value);
+  JL_GC_POP();
+}
+
+void JuliaObject::release_child(int index)
+{
+  if(!m_converted[index] || m_values[index].userType() != QMetaType::QObjectStar)
+  {
+    return;
+  }
+  JuliaObject* child = qobject_cast<JuliaObject*>(m_values[index].value<QObject*>());
+  if(child != nullptr)
+  {
+    child->release(this);
+  }
+}
+
+void JuliaObject::write_julia_field(int index, jl_value_t* val)
+{
+  profiler::Scope profile_scope(profiler::Category::Property, m_meta_object->field_name(index));
   JL_GC_PUSH1(&val);
-  jl_set_nth_field(m_julia_object, map_it->second, val);
+  // Takes care of the write barrier for pointer fields
+  jl_set_nth_field(m_julia_object, index, val);
   JL_GC_POP();
+
+  field_written(index);
+}
+
+void JuliaObject::write_inline_field(int index, const void* data)
+{
+  profiler::Scope profile_scope(profiler::Category::Property, m_meta_object->field_name(index));
+  // Bits fields hold no references, so no write barrier is needed
+  const detail::JuliaTypeMetaObject::Field& f = m_meta_object->field(index);
+  std::memcpy(static_cast<char*>(jl_data_ptr(m_julia_object)) + f.offset, data, f.size);
+
+  field_written(index);
+}
+
+void JuliaObject::field_written(int index)
+{
+  // The new value is known to QML, so refresh must not report it
+  snapshot_field(index);
+  m_meta_object->notify(this, index);
+}
+
+void JuliaObject::snapshot_field(int index)
+{
+  const detail::JuliaTypeMetaObject::Field& f = m_meta_object->field(index);
+  const char* data = static_cast<const char*>(jl_data_ptr(m_julia_object)) + f.offset;
+  char* snapshot_data = m_snapshot.data() + f.offset;
+  if(f.kind == detail::JuliaTypeMetaObject::FieldKind::String && (m_snapshot_roots[index] == GCRootArena::invalid_handle || std::memcmp(data, snapshot_data, f.size) != 0))
+  {
+    detail::wrapper_roots()->release(m_snapshot_roots[index]);
+    m_snapshot_roots[index] = detail::wrapper_roots()->protect(jl_fieldref(m_julia_object, index));
+  }
+  std::memcpy(snapshot_data, data, f.size);
+}
+
+int JuliaObject::refresh()
+{
+  QSet<JuliaObject*> visited;
+  return refresh_fields(visited);
+}
+
+int JuliaObject::refresh_fields(QSet<JuliaObject*>& visited)
+{
+  typedef detail::JuliaTypeMetaObject::FieldKind FieldKind;
+  // Objects referring to each other share their wrappers, so each wrapper is refreshed only once
+  if(m_meta_object == nullptr || visited.contains(this))
+  {
+    return 0;
+  }
+  visited.insert(this);
+
+  const char* data = static_cast<const char*>(jl_data_ptr(m_julia_object));
+  std::vector<int> changed;
+  int nb_changed_children = 0;
+  const int nb_fields = m_meta_object->nb_fields();
+  for(int i = 0; i != nb_fields; ++i)
+  {
+    const detail::JuliaTypeMetaObject::Field& f = m_meta_object->field(i);
+    // Pointer fields compare by identity here. Old strings are rooted by the snapshot and objects by their wrapper, so their address can't be reused.
+    const bool bytes_changed = std::memcmp(data + f.offset, m_snapshot.constData() + f.offset, f.size) != 0;
+    if(f.kind != FieldKind::Variant)
+    {
+      if(bytes_changed)
+      {
+        changed.push_back(i);
+      }
+      continue;
+    }
+
+    // QML never read the field, so nothing depends on it
+    if(!m_converted[i])
+    {
+      continue;
+    }
+
+    JuliaObject* child = m_values[i].userType() == QMetaType::QObjectStar ? qobject_cast<JuliaObject*>(m_values[i].value<QObject*>()) : nullptr;
+    if(!bytes_changed && (child != nullptr || !f.is_pointer))
+    {
+      // The same mutable object may have changed fields itself
+      if(child != nullptr && f.is_pointer)
+      {
+        nb_changed_children += child->refresh_fields(visited);
+      }
+      continue;
+    }
+
+    // Arrays and other converted values may be changed in place, so these are converted again and compared
+    const QVariant old_value = m_values[i];
+    m_converted[i] = false;
+    if(read_field(i) != old_value)
+    {
+      changed.push_back(i);
+    }
+    // Converting again took a new reference to the wrapper of the field, which may be the same wrapper
+    if(child != nullptr)
+    {
+      child->release(this);
+    }
+  }
+
+  for(int i = 0; i != nb_fields; ++i)
+  {
+    snapshot_field(i);
+  }
+
+  // Notify only once all values are up to date, and without writing them back to Julia
+  for(const int i : changed)
+  {
+    m_meta_object->notify(this, i);
+  }
+  return changed.size() + nb_changed_children;
 }
 
 void JuliaObject::set(const QString& key, const QVariant& value)
 {
-  if(!this->contains(key))
+  const int index = m_meta_object == nullptr ? -1 : m_meta_object->field_index(key);
+  if(index == -1)
   {
     throw std::runtime_error("JuliaObject has no key named " + key.toStdString());
   }
 
-  this->insert(key, value);
-  emit valueChanged(key, value);
+  write_field(index, value);
+}
+
+QVariant JuliaObject::value(const QString& key)
+{
+  const int index = m_meta_object == nullptr ? -1 : m_meta_object->field_index(key);
+  if(index == -1)
+  {
+    return QVariant();
+  }
+  return read_field(index);
 }
 
 } // namespace qmlwrap
@@ -1,31 +1,119 @@
 #ifndef QML_JULIA_OBJECT_H
 #define QML_JULIA_OBJECT_H
 
-#include <string>
-#include <map>
+#include <vector>
 
+#include <QByteArray>
+#include <QHash>
+#include <QJSEngine>
 #include <QObject>
-#include <QQmlPropertyMap>
+#include <QSet>
+#include <QVariant>
 
+#include "gc_root_arena.hpp"
 #include "type_conversion.hpp"
 
 namespace qmlwrap
 {
 
-/// Wrap Julia composite types
-class JuliaObject : public QQmlPropertyMap
+namespace detail
+{
+  class JuliaTypeMetaObject;
+}
+
+/// Wrap Julia composite types. Each field is a property of the object, with its own change signal. The properties come from a meta object
+/// that is shared by all objects of the same Julia type. Fields of basic bits types are typed properties that read the Julia object directly,
+/// other fields are converted to QVariant the first time they are read, so only the fields that are used cost anything.
+/// There is at most one JuliaObject for each Julia object, shared by all its owners.
+class JuliaObject : public QObject
 {
   Q_OBJECT
 public:
-  JuliaObject(jl_value_t* julia_object, QObject* parent = 0);
+  /// Get the wrapper for julia_object, creating it if there is none, and add a reference from owner. Each call must be matched by a release,
+  /// unless the owner is destroyed. The wrapper is deleted when it has no owners left, or when its only owners are wrappers that it owns itself.
+  static JuliaObject* wrap(jl_value_t* julia_object, QObject* owner);
+
   virtual ~JuliaObject();
+
+  /// Remove a reference from owner, deleting the wrapper later if nothing else uses it
+  void release(QObject* owner);
+
+  /// Like release, but if owner held the last reference the wrapper is handed to the garbage collector of engine instead of deleted,
+  /// so JavaScript code that kept a reference to it can still use it. The wrapper is then no longer shared by later calls to wrap.
+  void release_to_javascript(QObject* owner, QJSEngine* engine);
+
   /// Update a value. Updating a non-existant key is an error.
   void set(const QString& key, const QVariant& value);
-private slots:
-  void onValueChanged(const QString &key, const QVariant &value);
+
+  /// Value of the given field, or an invalid QVariant if there is no such field
+  QVariant value(const QString& key);
+
+  /// Notify QML of the fields that were changed in Julia since the last refresh or write, including those of nested objects.
+  /// Returns the number of changed fields.
+  int refresh();
+
 private:
+  friend class detail::JuliaTypeMetaObject;
+
+  JuliaObject(jl_value_t* julia_object);
+
+  void add_owner(QObject* owner);
+
+  /// Remove an owner with all its references, deleting the wrapper if it is no longer used, right away or later
+  void remove_owner(QObject* owner, bool delete_later);
+
+  /// Delete the wrapper if it has no owners, or if its owners are only wrappers that are not used from outside, such as two objects referring to each other
+  void delete_if_unused(bool delete_later);
+
+  /// True if a chain of wrapper owners leads to an owner that is not a wrapper. visited collects the wrappers that were checked.
+  bool used_from_outside(QSet<JuliaObject*>& visited);
+
+  /// Disconnect from all owners and remove the wrapper from the map of wrappers
+  void forget_owners();
+
+  /// Forget all owners and delete the wrapper
+  void discard(bool delete_later);
+
+  /// Value of the field with the given index, converting QVariant fields if this was not done yet
+  QVariant read_field(int index);
+
+  /// Store a new value for the field, converted to the type of the field
+  void write_field(int index, const QVariant& value);
+
+  /// Drop the reference to the wrapper of the field, if it holds one
+  void release_child(int index);
+
+  /// Store a Julia value in the field of the Julia object and notify QML
+  void write_julia_field(int index, jl_value_t* val);
+
+  /// Copy a value of the C++ type of an inline field into the Julia object and notify QML
+  void write_inline_field(int index, const void* data);
+
+  /// Implementation of refresh, skipping the wrappers in visited and adding this one
+  int refresh_fields(QSet<JuliaObject*>& visited);
+
+  /// Update the snapshot after a write and emit the change signal
+  void field_written(int index);
+
+  /// Copy the current value of a field to the snapshot
+  void snapshot_field(int index);
+
   jl_value_t* m_julia_object;
-  std::map<std::string, uint32_t> m_field_mapping;
+  GCRootArena::Handle m_julia_object_root = GCRootArena::invalid_handle;
+  detail::JuliaTypeMetaObject* m_meta_object;
+  // Converted values of the QVariant fields
+  std::vector<QVariant> m_values;
+  std::vector<bool> m_converted;
+  // Copy of the Julia object data as last seen by QML, to detect changes
+  QByteArray m_snapshot;
+  // Roots of the strings in the snapshot, which are compared by address, so their memory can't be reused by a new string
+  std::vector<GCRootArena::Handle> m_snapshot_roots;
+  struct Owner
+  {
+    QMetaObject::Connection destroyed_connection;
+    int nb_references;
+  };
+  QHash<QObject*, Owner> m_owners;
 };
 
 }
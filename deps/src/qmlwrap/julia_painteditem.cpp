@@ -5,6 +5,7 @@
 #include "julia_api.hpp"
 #include "julia_painteditem.hpp"
 #include "julia_object.hpp"
+#include "profiler.hpp"
 
 namespace qmlwrap
 {
@@ -19,6 +20,7 @@ JuliaPaintedItem::JuliaPaintedItem(QQuickItem *parent) : QQuickPaintedItem(paren
 
 void JuliaPaintedItem::paint(QPainter* painter)
 {
+  profiler::Scope profile_scope(profiler::Category::Paint, metaObject()->className());
   m_callback(painter, this);
 }
 
@@ -1,101 +1,540 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+
 #include <QDebug>
+#include <QMetaMethod>
 #include <QMetaObject>
+#include <QPointer>
 #include <QQmlEngine>
 #include <QString>
 #include <QVariant>
 #include <QVariantList>
+#include <QVarLengthArray>
 
 #include "julia_api.hpp"
+#include "julia_object.hpp"
 #include "julia_signals.hpp"
+#include "profiler.hpp"
 #include "type_conversion.hpp"
 
-// Q_ARG is a macro, so we use one too
-#define MAKE_Q_ARG(cpptype) \
-if(jl_types_equal(jl_typeof(v), (jl_value_t*)cxx_wrap::julia_type<cpptype>())) \
-{ \
-  auto ptr = std::make_shared<argument_wrapper_impl<cpptype>>(); \
-  wrappers.push_back(ptr); \
-  ptr->value = cxx_wrap::convert_to_cpp<cpptype>(v); \
-  return Q_ARG(cpptype, ptr->value); \
-}
-
 namespace qmlwrap
 {
 
 namespace detail
 {
-  // This is needed because QGenericArgument is a weak reference to a value, so the value needs to exist as long as the QGenericArgument instance
-  struct argument_wrapper
+  // Number of arguments that fit in the stack buffers used for emitting
+  static const int nb_stack_args = 8;
+
+  // Wrappers of the composite arguments of one emission. The JuliaSignals block owns them only until the emission is delivered.
+  // Wrappers that nothing else, such as a context, uses are then left to the JavaScript garbage collector, since a handler may have kept them.
+  class ArgumentWrappers
   {
-    virtual ~argument_wrapper() {}
+  public:
+    explicit ArgumentWrappers(QObject* owner) : m_owner(owner)
+    {
+    }
+
+    ~ArgumentWrappers()
+    {
+      QJSEngine* engine = JuliaAPI::instance()->js_engine();
+      for(const QPointer<JuliaObject>& wrapper : m_wrappers)
+      {
+        if(!wrapper.isNull())
+        {
+          wrapper->release_to_javascript(m_owner, engine);
+        }
+      }
+    }
+
+    JuliaObject* wrap(jl_value_t* v)
+    {
+      JuliaObject* wrapper = JuliaObject::wrap(v, m_owner);
+      m_wrappers.push_back(wrapper);
+      return wrapper;
+    }
+
+  private:
+    QObject* m_owner;
+    QVarLengthArray<QPointer<JuliaObject>, nb_stack_args> m_wrappers;
   };
 
-  template<typename T>
-  struct argument_wrapper_impl : public argument_wrapper
+  // Bulk conversion of a typed numeric array to a QList, which QML shows as a JavaScript array without a QVariant per element.
+  // Gives an invalid QVariant for other arrays. Integers that don't fit an int become JavaScript numbers.
+  QVariant numeric_array_value(jl_array_t* arr)
   {
-    T value;
-  };
+    QList<int> ints;
+    if(convert_array_to_qt<int32_t>(arr, ints))
+    {
+      return QVariant::fromValue(ints);
+    }
+    QList<qreal> reals;
+    if(try_convert_array_to_qt<double, float, int64_t, uint32_t, uint64_t>(arr, reals))
+    {
+      return QVariant::fromValue(reals);
+    }
+    return QVariant();
+  }
 
-  QGenericArgument make_arg(std::vector<std::shared_ptr<argument_wrapper>>& wrappers, jl_value_t* v)
+  // Convert a Julia value to a QObject*, wrapping composite types in a JuliaObject held for the emission, or reusing its existing wrapper
+  QObject* convert_signal_object(jl_value_t* v, ArgumentWrappers& wrappers)
   {
-    // Because Q_ARG is a macro, we have no choice but to enumerate all types here
-    MAKE_Q_ARG(bool)
-    MAKE_Q_ARG(double)
-    MAKE_Q_ARG(int)
-    if(jl_type_morespecific(jl_typeof(v), (jl_value_t*)cxx_wrap::julia_type<QString>()))
+    if(jl_type_morespecific(jl_typeof(v), (jl_value_t*)cxx_wrap::julia_type<QObject>()))
+    {
+      return cxx_wrap::convert_to_cpp<QObject*>(v);
+    }
+    if(jl_is_structtype(jl_typeof(v)))
     {
-      auto ptr = std::make_shared<argument_wrapper_impl<QString>>();
-      wrappers.push_back(ptr);
-      ptr->value = cxx_wrap::convert_to_cpp<QString>(v);
-      return Q_ARG(QString, ptr->value);
+      return wrappers.wrap(v);
     }
+    return nullptr;
+  }
 
-    throw std::runtime_error("Failed to convert signal argument of type " + cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(v)));
+  // Narrow an integer to an int signal parameter, refusing values that would wrap around
+  int checked_int(const qint64 x, const char* signal_name)
+  {
+    if(x < std::numeric_limits<int>::min() || x > std::numeric_limits<int>::max())
+    {
+      throw std::runtime_error("Value " + std::to_string(x) + " is out of range for an int parameter of signal " + std::string(signal_name));
+    }
+    return static_cast<int>(x);
   }
 
-  template<std::size_t... Is>
-  struct ApplyVectorArgs
+  // Convert a Julia value to a QVariant holding exactly the given Qt type, so its data can be passed on to a metacall
+  QVariant convert_signal_arg(jl_value_t* v, const int type_id, ArgumentWrappers& wrappers, const char* signal_name)
   {
-    void operator()(QObject* o, const char* signal_name, cxx_wrap::ArrayRef<jl_value_t*> args)
+    switch(type_id)
+    {
+    case QMetaType::Bool:
+      if(jl_is_bool(v))
+        return QVariant(jl_unbox_bool(v) != 0);
+      break;
+    case QMetaType::Int:
+      if(jl_typeis(v, jl_int32_type))
+        return QVariant(static_cast<int>(jl_unbox_int32(v)));
+      if(jl_typeis(v, jl_int64_type))
+        return QVariant(checked_int(jl_unbox_int64(v), signal_name));
+      break;
+    case QMetaType::Double:
+      if(jl_typeis(v, jl_float64_type))
+        return QVariant(jl_unbox_float64(v));
+      if(jl_typeis(v, jl_float32_type))
+        return QVariant(static_cast<double>(jl_unbox_float32(v)));
+      if(jl_typeis(v, jl_int64_type))
+        return QVariant(static_cast<double>(jl_unbox_int64(v)));
+      if(jl_typeis(v, jl_int32_type))
+        return QVariant(static_cast<double>(jl_unbox_int32(v)));
+      break;
+    case QMetaType::QString:
+      if(jl_type_morespecific(jl_typeof(v), (jl_value_t*)cxx_wrap::julia_type<QString>()))
+        return QVariant(cxx_wrap::convert_to_cpp<QString>(v));
+      break;
+    case QMetaType::QVariant:
     {
-      if(sizeof...(Is) == args.size())
+      if(jl_is_array(v))
       {
-        std::vector<std::shared_ptr<argument_wrapper>> wrappers; wrappers.reserve(sizeof...(Is));
-        if(!QMetaObject::invokeMethod(o, signal_name, make_arg(wrappers, args[Is])...))
-        {
-          throw std::runtime_error("Error emitting or finding signal " + std::string(signal_name));
-        }
+        const QVariant list = numeric_array_value((jl_array_t*)v);
+        if(list.isValid())
+          return list;
       }
-      else
+      QVariant result = cxx_wrap::convert_to_cpp<QVariant>(v);
+      if(result.isNull())
       {
-        ApplyVectorArgs<Is..., sizeof...(Is)>()(o, signal_name, args);
+        QObject* obj = convert_signal_object(v, wrappers);
+        if(obj != nullptr)
+          result = QVariant::fromValue(obj);
       }
+      if(!result.isNull())
+        return result;
+      break;
     }
-  };
-
-  // end recursion
-  template<>
-  struct ApplyVectorArgs<0,1,2,3,4,5,6,7,8,9,10>
-  {
-    void operator()(QObject* o, const char* signal_name, cxx_wrap::ArrayRef<jl_value_t*> args)
+    case QMetaType::QVariantList:
+      if(jl_is_array(v))
+        return QVariant(cxx_wrap::convert_to_cpp<QVariant>(v).toList());
+      break;
+    default:
     {
-      throw std::runtime_error("Too many arguments for signal " + std::string(signal_name));
+      if(QMetaType::typeFlags(type_id) & QMetaType::PointerToQObject)
+      {
+        // QML object types, e.g. a parameter declared as QtObject or ListModel
+        QObject* obj = convert_signal_object(v, wrappers);
+        const QMetaObject* meta = QMetaType::metaObjectForType(type_id);
+        if(obj != nullptr && (meta == nullptr || meta->cast(obj) != nullptr))
+          return QVariant(type_id, &obj);
+        break;
+      }
+      // Anything else that Qt knows how to convert, e.g. a string to a url
+      QVariant result = cxx_wrap::convert_to_cpp<QVariant>(v);
+      if(!result.isNull() && result.convert(type_id))
+        return result;
+      break;
     }
-  };
+    }
+
+    throw std::runtime_error("Failed to convert signal argument of type " + cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(v)) + " to " + QMetaType::typeName(type_id));
+  }
 }
 
-JuliaSignals::JuliaSignals(QObject* parent) : QObject(parent)
+JuliaSignals::JuliaSignals(QObject* parent) : QObject(parent), m_queue_head(nullptr), m_gc_roots(new GCRootArena("JuliaSignals", this))
 {
   JuliaAPI::instance()->setJuliaSignals(this);
+  m_coalesce_timer.setSingleShot(true);
+  QObject::connect(&m_coalesce_timer, &QTimer::timeout, this, &JuliaSignals::flush_coalesced_signals);
 }
 
 JuliaSignals::~JuliaSignals()
 {
+  if(JuliaAPI::instance()->juliaSignals() == this)
+  {
+    JuliaAPI::instance()->setJuliaSignals(nullptr);
+  }
+
+  QueuedSignal* queued = m_queue_head.exchange(nullptr);
+  while(queued != nullptr)
+  {
+    QueuedSignal* next = queued->next;
+    delete queued;
+    queued = next;
+  }
 }
 
 void JuliaSignals::emit_signal(const char* signal_name, cxx_wrap::ArrayRef<jl_value_t*> args)
 {
-  detail::ApplyVectorArgs<>()(this, signal_name, args);
+  profiler::Scope profile_scope(profiler::Category::Signal, signal_name);
+  SignalInfo& info = signal_info(signal_name);
+  const int nb_args = args.size();
+  if(nb_args != info.parameter_types.size())
+  {
+    throw std::runtime_error("Signal " + std::string(signal_name) + " expects " + std::to_string(info.parameter_types.size()) + " arguments, got " + std::to_string(nb_args));
+  }
+
+  if(!is_due(info))
+  {
+    // Most held back emissions are replaced by a later one, so they are only converted when they are really emitted
+    hold_pending(info);
+    for(int i = 0; i != nb_args; ++i)
+    {
+      info.pending_julia_args.push_back(m_gc_roots->protect(args[i]));
+    }
+    return;
+  }
+
+  detail::ArgumentWrappers wrappers(this);
+  QVarLengthArray<QVariant, detail::nb_stack_args> values(nb_args);
+  for(int i = 0; i != nb_args; ++i)
+  {
+    values[i] = detail::convert_signal_arg(args[i], info.parameter_types[i], wrappers, signal_name);
+  }
+  deliver(info, values.data());
+}
+
+void JuliaSignals::queue_signal(const char* signal_name, cxx_wrap::ArrayRef<jl_value_t*> args)
+{
+  // Conversion to the parameter types happens on the GUI thread, only generic conversion is done here
+  std::unique_ptr<QueuedSignal> queued(new QueuedSignal());
+  queued->name = QByteArray(signal_name);
+  const int nb_args = args.size();
+  queued->args.reserve(nb_args);
+  for(int i = 0; i != nb_args; ++i)
+  {
+    QVariant arg = cxx_wrap::convert_to_cpp<QVariant>(args[i]);
+    if(arg.isNull())
+    {
+      // Wrapping in a JuliaObject must happen on the GUI thread, while the value would have to be kept alive from the calling thread
+      if(jl_is_structtype(jl_typeof(args[i])))
+      {
+        throw std::runtime_error("Composite type " + cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(args[i])) + " can't be passed to queued signal " + std::string(signal_name) + ", objects are only supported when emitting from the main thread");
+      }
+      throw std::runtime_error("Unsupported argument of type " + cxx_wrap::julia_type_name((jl_datatype_t*)jl_typeof(args[i])) + " for queued signal " + std::string(signal_name));
+    }
+    queued->args.push_back(arg);
+  }
+
+  QueuedSignal* old_head = m_queue_head.load(std::memory_order_relaxed);
+  do
+  {
+    queued->next = old_head;
+  } while(!m_queue_head.compare_exchange_weak(old_head, queued.get(), std::memory_order_release, std::memory_order_relaxed));
+  queued.release();
+
+  // Only the push onto an empty queue needs to wake up the event loop, the others are handled in the same batch
+  if(old_head == nullptr)
+  {
+    QMetaObject::invokeMethod(this, "process_queued_signals", Qt::QueuedConnection);
+  }
+}
+
+void JuliaSignals::process_queued_signals()
+{
+  // Take the whole stack and reverse it to emit in the order of queueing
+  QueuedSignal* stack = m_queue_head.exchange(nullptr, std::memory_order_acquire);
+  QueuedSignal* ordered = nullptr;
+  while(stack != nullptr)
+  {
+    QueuedSignal* next = stack->next;
+    stack->next = ordered;
+    ordered = stack;
+    stack = next;
+  }
+
+  while(ordered != nullptr)
+  {
+    std::unique_ptr<QueuedSignal> queued(ordered);
+    ordered = ordered->next;
+    try
+    {
+      emit_queued_signal(*queued);
+    }
+    catch(const std::runtime_error& e)
+    {
+      qWarning() << "Error emitting queued signal: " << e.what();
+    }
+  }
+}
+
+void JuliaSignals::emit_queued_signal(QueuedSignal& queued)
+{
+  SignalInfo& info = signal_info(queued.name.constData());
+  const int nb_args = queued.args.size();
+  if(nb_args != info.parameter_types.size())
+  {
+    throw std::runtime_error("Signal " + queued.name.toStdString() + " expects " + std::to_string(info.parameter_types.size()) + " arguments, got " + std::to_string(nb_args));
+  }
+
+  for(int i = 0; i != nb_args; ++i)
+  {
+    const int type_id = info.parameter_types[i];
+    // QVariant truncates 64 bit integers converted to int
+    if(type_id == QMetaType::Int && queued.args[i].userType() == QMetaType::LongLong)
+    {
+      queued.args[i] = detail::checked_int(queued.args[i].toLongLong(), queued.name.constData());
+    }
+    else if(type_id == QMetaType::Int && queued.args[i].userType() == QMetaType::ULongLong)
+    {
+      const qulonglong x = queued.args[i].toULongLong();
+      queued.args[i] = detail::checked_int(x > qulonglong(std::numeric_limits<qint64>::max()) ? std::numeric_limits<qint64>::max() : qint64(x), queued.name.constData());
+    }
+    if(type_id != QMetaType::QVariant && !queued.args[i].convert(type_id))
+    {
+      throw std::runtime_error("Failed to convert argument " + std::to_string(i+1) + " of signal " + queued.name.toStdString() + " to " + QMetaType::typeName(type_id));
+    }
+  }
+  deliver(info, queued.args.data());
+}
+
+void JuliaSignals::set_max_rate(const char* signal_name, double max_rate)
+{
+  SignalInfo& info = signal_info(signal_name);
+  info.min_interval = max_rate > 0. ? std::max(qint64(1), qint64(1000./max_rate)) : 0;
+  if(info.min_interval == 0 && info.pending)
+  {
+    // Deliver what was held back, since the signal is no longer coalescing
+    info.pending = false;
+    info.last_delivery.start();
+    ++info.nb_delivered;
+    emit_pending(info);
+  }
+}
+
+int64_t JuliaSignals::delivered_count(const char* signal_name)
+{
+  return signal_info(signal_name).nb_delivered;
+}
+
+int64_t JuliaSignals::dropped_count(const char* signal_name)
+{
+  return signal_info(signal_name).nb_dropped;
+}
+
+void JuliaSignals::flush_coalesced_signals()
+{
+  // Collect the names first, since emitting may add to the cache
+  QVector<QByteArray> due_signals;
+  for(auto it = m_signal_cache.begin(); it != m_signal_cache.end(); ++it)
+  {
+    if(it->pending && it->last_delivery.elapsed() >= it->min_interval)
+    {
+      due_signals.push_back(it.key());
+    }
+  }
+
+  for(const QByteArray& name : due_signals)
+  {
+    SignalInfo& info = signal_info(name.constData());
+    info.pending = false;
+    info.last_delivery.start();
+    ++info.nb_delivered;
+    try
+    {
+      emit_pending(info);
+    }
+    catch(const std::runtime_error& e)
+    {
+      qWarning() << "Error emitting coalesced signal: " << e.what();
+    }
+  }
+
+  schedule_coalesced_signals();
+}
+
+bool JuliaSignals::is_due(const SignalInfo& info) const
+{
+  return info.min_interval == 0 || (!info.pending && (!info.last_delivery.isValid() || info.last_delivery.elapsed() >= info.min_interval));
+}
+
+void JuliaSignals::deliver(SignalInfo& info, QVariant* values)
+{
+  if(info.min_interval == 0)
+  {
+    activate(info, values);
+    return;
+  }
+
+  if(is_due(info))
+  {
+    info.last_delivery.start();
+    ++info.nb_delivered;
+    activate(info, values);
+    return;
+  }
+
+  hold_pending(info);
+  const int nb_args = info.parameter_types.size();
+  info.pending_args.resize(nb_args);
+  for(int i = 0; i != nb_args; ++i)
+  {
+    info.pending_args[i] = values[i];
+  }
+}
+
+void JuliaSignals::hold_pending(SignalInfo& info)
+{
+  if(info.pending)
+  {
+    ++info.nb_dropped;
+  }
+  release_pending(info);
+
+  if(!info.pending)
+  {
+    info.pending = true;
+    schedule_coalesced_signals();
+  }
+}
+
+void JuliaSignals::release_pending(SignalInfo& info)
+{
+  for(const GCRootArena::Handle h : info.pending_julia_args)
+  {
+    m_gc_roots->release(h);
+  }
+  info.pending_julia_args.clear();
+  info.pending_args.clear();
+}
+
+void JuliaSignals::emit_pending(SignalInfo& info)
+{
+  if(info.pending_julia_args.isEmpty())
+  {
+    QVector<QVariant> args;
+    args.swap(info.pending_args);
+    activate(info, args.data());
+    return;
+  }
+
+  // Taken out of the info, since emitting may add to the signal cache and move it
+  QVector<GCRootArena::Handle> handles;
+  handles.swap(info.pending_julia_args);
+  const QVector<int> parameter_types = info.parameter_types;
+  const QByteArray signal_name = metaObject()->method(info.method_index).name();
+  const int nb_args = handles.size();
+  QVarLengthArray<QVariant, detail::nb_stack_args> values(nb_args);
+  try
+  {
+    detail::ArgumentWrappers wrappers(this);
+    for(int i = 0; i != nb_args; ++i)
+    {
+      values[i] = detail::convert_signal_arg(m_gc_roots->value(handles[i]), parameter_types[i], wrappers, signal_name.constData());
+    }
+    activate(info, values.data());
+  }
+  catch(...)
+  {
+    for(const GCRootArena::Handle h : handles)
+    {
+      m_gc_roots->release(h);
+    }
+    throw;
+  }
+  for(const GCRootArena::Handle h : handles)
+  {
+    m_gc_roots->release(h);
+  }
+}
+
+void JuliaSignals::schedule_coalesced_signals()
+{
+  qint64 wait_time = -1;
+  for(const SignalInfo& info : m_signal_cache)
+  {
+    if(info.pending)
+    {
+      const qint64 remaining = std::max(qint64(0), info.min_interval - info.last_delivery.elapsed());
+      wait_time = wait_time < 0 ? remaining : std::min(wait_time, remaining);
+    }
+  }
+
+  if(wait_time >= 0)
+  {
+    m_coalesce_timer.start(static_cast<int>(wait_time));
+  }
+}
+
+JuliaSignals::SignalInfo& JuliaSignals::signal_info(const char* signal_name)
+{
+  // Raw data avoids a copy of the name for the lookup
+  const QByteArray lookup_name = QByteArray::fromRawData(signal_name, qstrlen(signal_name));
+  auto cached = m_signal_cache.find(lookup_name);
+  if(cached != m_signal_cache.end())
+  {
+    return cached.value();
+  }
+
+  const QMetaObject* meta = metaObject();
+  const int nb_methods = meta->methodCount();
+  for(int i = 0; i != nb_methods; ++i)
+  {
+    const QMetaMethod method = meta->method(i);
+    if(method.methodType() != QMetaMethod::Signal || method.name() != lookup_name)
+    {
+      continue;
+    }
+
+    SignalInfo info;
+    info.method_index = i;
+    const int nb_params = method.parameterCount();
+    info.parameter_types.reserve(nb_params);
+    for(int j = 0; j != nb_params; ++j)
+    {
+      info.parameter_types.push_back(method.parameterType(j));
+    }
+    return m_signal_cache.insert(QByteArray(signal_name), info).value();
+  }
+
+  throw std::runtime_error("Error emitting or finding signal " + std::string(signal_name));
+}
+
+void JuliaSignals::activate(const SignalInfo& info, QVariant* values)
+{
+  const int nb_args = info.parameter_types.size();
+  // argv[0] is the return value, which is always void for signals
+  QVarLengthArray<void*, detail::nb_stack_args+1> argv(nb_args+1);
+  argv[0] = nullptr;
+  for(int i = 0; i != nb_args; ++i)
+  {
+    argv[i+1] = info.parameter_types[i] == QMetaType::QVariant ? &values[i] : values[i].data();
+  }
+  QMetaObject::metacall(this, QMetaObject::InvokeMetaMethod, info.method_index, argv.data());
 }
 
 } // namespace qmlwrap
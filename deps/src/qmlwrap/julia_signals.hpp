@@ -1,9 +1,19 @@
 #ifndef QML_JULIA_SIGNALS_H
 #define QML_JULIA_SIGNALS_H
 
+#include <atomic>
+
 #include <cxx_wrap.hpp>
 
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
+#include <QTimer>
+#include <QVariant>
+#include <QVector>
+
+#include "gc_root_arena.hpp"
 
 namespace qmlwrap
 {
@@ -18,6 +28,86 @@ public:
   // Emit the signal with the given name
 public slots:
   void emit_signal(const char* signal_name, cxx_wrap::ArrayRef<jl_value_t*> args);
+
+public:
+  /// Thread-safe version of emit_signal: arguments are converted on the calling thread and the signal is emitted later from the thread of this object.
+  /// Composite types are not supported, since their JuliaObject wrapper can only be created on the GUI thread.
+  void queue_signal(const char* signal_name, cxx_wrap::ArrayRef<jl_value_t*> args);
+
+  /// Limit the emission rate of the given signal to max_rate emissions per second. Emissions in between are collapsed, so only the latest arguments get delivered. A rate of 0 disables coalescing.
+  void set_max_rate(const char* signal_name, double max_rate);
+
+  /// Number of times a coalescing signal was really emitted
+  int64_t delivered_count(const char* signal_name);
+
+  /// Number of emissions of a coalescing signal that were replaced by a later one
+  int64_t dropped_count(const char* signal_name);
+
+private slots:
+  /// Emit all queued signals in one batch
+  void process_queued_signals();
+
+  /// Emit the coalesced signals whose interval has elapsed
+  void flush_coalesced_signals();
+
+private:
+  /// Signal waiting in the queue, with arguments already converted
+  struct QueuedSignal
+  {
+    QByteArray name;
+    QVector<QVariant> args;
+    QueuedSignal* next;
+  };
+
+  /// Cached lookup result for a signal
+  struct SignalInfo
+  {
+    int method_index;
+    QVector<int> parameter_types;
+    // Coalescing state, unused if min_interval is 0
+    qint64 min_interval = 0;
+    QElapsedTimer last_delivery;
+    bool pending = false;
+    // Held back arguments, converted if they came from the queue, or the Julia values if they came from emit_signal
+    QVector<QVariant> pending_args;
+    QVector<GCRootArena::Handle> pending_julia_args;
+    int64_t nb_delivered = 0;
+    int64_t nb_dropped = 0;
+  };
+
+  /// Get the signal info, looking it up in the meta object only the first time a signal is used
+  SignalInfo& signal_info(const char* signal_name);
+
+  /// True if the signal can be emitted now, false if it is coalescing and must wait for its interval to elapse
+  bool is_due(const SignalInfo& info) const;
+
+  /// Emit now, or hold on to the arguments if the signal is coalescing and its interval did not elapse yet
+  void deliver(SignalInfo& info, QVariant* values);
+
+  /// Replace the held back arguments of a coalescing signal, counting the replaced ones as dropped
+  void hold_pending(SignalInfo& info);
+
+  /// Forget the held back arguments
+  void release_pending(SignalInfo& info);
+
+  /// Emit a coalescing signal with its held back arguments, converting them first if they are Julia values
+  void emit_pending(SignalInfo& info);
+
+  /// Restart the coalescing timer for the earliest pending signal
+  void schedule_coalesced_signals();
+
+  /// Emit the signal using the given argument values, which must match the signal parameter types
+  void activate(const SignalInfo& info, QVariant* values);
+
+  /// Convert the queued arguments to the signal parameter types and emit
+  void emit_queued_signal(QueuedSignal& queued);
+
+  QHash<QByteArray, SignalInfo> m_signal_cache;
+  // Lock-free stack of queued signals, pushed from any thread and emptied in one go by process_queued_signals
+  std::atomic<QueuedSignal*> m_queue_head;
+  QTimer m_coalesce_timer;
+  // Keeps the Julia values of held back emissions alive
+  GCRootArena* m_gc_roots;
 };
 
 } // namespace qmlwrap
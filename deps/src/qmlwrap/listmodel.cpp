@@ -3,42 +3,25 @@
 #include <QDebug>
 #include <QQmlListProperty>
 #include "listmodel.hpp"
+#include "profiler.hpp"
 
 namespace qmlwrap
 {
 
-ListModel::ListModel(const cxx_wrap::ArrayRef<jl_value_t*>& array, jl_function_t* f, QObject* parent) : QAbstractListModel(parent), m_array(array), m_update_array(f)
+ListModel::ListModel(const cxx_wrap::ArrayRef<jl_value_t*>& array, jl_function_t* f, QObject* parent) : QAbstractListModel(parent), m_array(array), m_update_array(f), m_gc_roots(new GCRootArena("ListModel", this))
 {
   m_rolenames[0] = "string";
   m_getters.push_back(cxx_wrap::JuliaFunction("string").pointer());
   m_setters.push_back(nullptr);
-  cxx_wrap::protect_from_gc(m_array.wrapped());
-  if(f != nullptr)
-  {
-    cxx_wrap::protect_from_gc(f);
-  }
+  m_getter_roots.push_back(GCRootArena::invalid_handle); // Base.string is always reachable
+  m_setter_roots.push_back(GCRootArena::invalid_handle);
+  // Protected for the lifetime of the model, released with the arena
+  m_gc_roots->protect((jl_value_t*)m_array.wrapped());
+  m_gc_roots->protect(f);
 }
 
 ListModel::~ListModel()
 {
-  cxx_wrap::unprotect_from_gc(m_array.wrapped());
-  if(m_update_array != nullptr)
-  {
-    cxx_wrap::unprotect_from_gc(m_update_array);
-  }
-
-  for(jl_function_t* f : m_getters)
-  {
-    cxx_wrap::unprotect_from_gc(f);
-  }
-
-  for(jl_function_t* f : m_setters)
-  {
-    if(f != nullptr)
-    {
-      cxx_wrap::unprotect_from_gc(f);
-    }
-  }
 }
 
 int	ListModel::rowCount(const QModelIndex& parent) const
@@ -53,6 +36,7 @@ QVariant ListModel::data(const QModelIndex& index, int role) const
     qWarning() << "Row index " << index << " is out of range for ListModel";
     return QVariant();
   }
+  profiler::Scope profile_scope(profiler::Category::RoleGet, profiler::active() ? m_rolenames.value(role) : QByteArray());
   QVariant result = cxx_wrap::convert_to_cpp<QVariant>(rolegetter(role)(m_array[index.row()]));
   return result;
 }
@@ -70,6 +54,7 @@ bool ListModel::setData(const QModelIndex& index, const QVariant& value, int rol
     return false;
   }
 
+  profiler::Scope profile_scope(profiler::Category::RoleSet, profiler::active() ? m_rolenames.value(role) : QByteArray());
   try
   {
     rolesetter(role)((jl_value_t*)m_array.wrapped(), cxx_wrap::box(value), index.row()+1);
@@ -266,18 +251,16 @@ void ListModel::addrole(const std::string& name, jl_function_t* getter, jl_funct
     m_rolenames.clear();
     m_getters.clear();
     m_setters.clear();
+    m_getter_roots.clear();
+    m_setter_roots.clear();
     m_custom_roles = true;
   }
 
-  cxx_wrap::protect_from_gc(getter);
-  if(setter != nullptr)
-  {
-    cxx_wrap::protect_from_gc(setter);
-  }
-
   m_rolenames[m_rolenames.size()] = name.c_str();
   m_getters.push_back(getter);
   m_setters.push_back(setter);
+  m_getter_roots.push_back(m_gc_roots->protect(getter));
+  m_setter_roots.push_back(m_gc_roots->protect(setter));
 
   emit rolesChanged();
 }
@@ -301,17 +284,10 @@ void ListModel::setrole(const int idx, const std::string& name, jl_function_t* g
     return;
   }
 
-  cxx_wrap::unprotect_from_gc(m_getters[idx]);
-  if(m_setters[idx] != nullptr)
-  {
-    cxx_wrap::unprotect_from_gc(m_setters[idx]);
-  }
-
-  cxx_wrap::protect_from_gc(getter);
-  if(setter != nullptr)
-  {
-    cxx_wrap::protect_from_gc(setter);
-  }
+  m_gc_roots->release(m_getter_roots[idx]);
+  m_gc_roots->release(m_setter_roots[idx]);
+  m_getter_roots[idx] = m_gc_roots->protect(getter);
+  m_setter_roots[idx] = m_gc_roots->protect(setter);
 
   m_getters[idx] = getter;
   m_setters[idx] = setter;
@@ -334,21 +310,22 @@ void ListModel::removerole(const int idx)
     return;
   }
 
-  cxx_wrap::unprotect_from_gc(m_getters[idx]);
-  if(m_setters[idx] != nullptr)
-  {
-    cxx_wrap::unprotect_from_gc(m_setters[idx]);
-  }
+  m_gc_roots->release(m_getter_roots[idx]);
+  m_gc_roots->release(m_setter_roots[idx]);
 
   const int nb_roles = m_getters.size();
   for(int i = idx; i != (nb_roles-1); ++i)
   {
     m_getters[i] = m_getters[i+1];
     m_setters[i] = m_setters[i+1];
+    m_getter_roots[i] = m_getter_roots[i+1];
+    m_setter_roots[i] = m_setter_roots[i+1];
     m_rolenames[i] = m_rolenames[i+1];
   }
   m_getters.resize(nb_roles-1);
   m_setters.resize(nb_roles-1);
+  m_getter_roots.resize(nb_roles-1);
+  m_setter_roots.resize(nb_roles-1);
   m_rolenames.remove(nb_roles-1);
 
   emit rolesChanged();
@@ -366,8 +343,9 @@ void ListModel::removerole(const std::string& name)
 
 void ListModel::setconstructor(jl_function_t* constructor)
 {
+  m_gc_roots->release(m_constructor_root);
   m_constructor = constructor;
-  cxx_wrap::protect_from_gc(m_constructor);
+  m_constructor_root = m_gc_roots->protect(m_constructor);
 }
 
 cxx_wrap::JuliaFunction ListModel::rolegetter(int role) const
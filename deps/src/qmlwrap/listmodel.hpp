@@ -8,6 +8,7 @@
 #include <QJSValue>
 #include <QObject>
 
+#include "gc_root_arena.hpp"
 #include "type_conversion.hpp"
 
 namespace qmlwrap
@@ -73,6 +74,11 @@ private:
   bool m_custom_roles = false;
   std::vector<jl_function_t*> m_getters;
   std::vector<jl_function_t*> m_setters;
+  // Keeps the array and the functions alive, releasing them all when the model is destroyed
+  GCRootArena* m_gc_roots;
+  GCRootArena::Handle m_constructor_root = GCRootArena::invalid_handle;
+  std::vector<GCRootArena::Handle> m_getter_roots;
+  std::vector<GCRootArena::Handle> m_setter_roots;
 };
 
 }
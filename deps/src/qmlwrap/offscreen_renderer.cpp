@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <memory>
+
+#include <QCoreApplication>
+#include <QOpenGLFunctions>
+#include <QQmlComponent>
+#include <QQmlContext>
+#include <QQmlEngine>
+
+#include "application_manager.hpp"
+#include "offscreen_renderer.hpp"
+#include "profiler.hpp"
+
+// Desktop OpenGL formats, missing from the OpenGL ES headers
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+#define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+
+namespace qmlwrap
+{
+
+namespace detail
+{
+  // Renderers that were not deleted yet
+  QSet<const OffscreenRenderer*>& live_renderers()
+  {
+    static QSet<const OffscreenRenderer*> renderers;
+    return renderers;
+  }
+}
+
+OffscreenRenderer::OffscreenRenderer(int width, int height, QObject* parent) : QObject(parent), m_width(width), m_height(height)
+{
+  if(width <= 0 || height <= 0)
+  {
+    throw std::runtime_error("Offscreen renderer size must be positive");
+  }
+
+  QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+  format.setDepthBufferSize(24);
+  format.setStencilBufferSize(8);
+  m_context = new QOpenGLContext(this);
+  m_context->setFormat(format);
+  if(!m_context->create())
+  {
+    throw std::runtime_error("Failed to create an OpenGL context for offscreen rendering");
+  }
+
+  // Owned here until everything succeeded, the context and the render control are deleted as children if this throws
+  std::unique_ptr<QOffscreenSurface> surface(new QOffscreenSurface());
+  surface->setFormat(m_context->format());
+  surface->create();
+  if(!surface->isValid())
+  {
+    throw std::runtime_error("Failed to create an offscreen surface for offscreen rendering");
+  }
+
+  // The window is never shown, the render control draws its scene into the framebuffer
+  m_render_control = new QQuickRenderControl(this);
+  std::unique_ptr<QQuickWindow> window(new QQuickWindow(m_render_control));
+  window->setGeometry(0, 0, m_width, m_height);
+
+  m_surface = surface.get();
+  m_window = window.get();
+  make_current();
+  m_render_control->initialize(m_context);
+  create_fbo();
+
+  surface.release();
+  window.release();
+  detail::live_renderers().insert(this);
+}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+  detail::live_renderers().remove(this);
+  // The scene graph must be released while the context is current
+  m_context->makeCurrent(m_surface);
+  delete_scene();
+  delete m_render_control;
+  delete m_fbo;
+  m_context->doneCurrent();
+  delete m_window;
+  delete m_surface;
+}
+
+OffscreenRenderer& OffscreenRenderer::checked(OffscreenRenderer& renderer)
+{
+  if(!detail::live_renderers().contains(&renderer))
+  {
+    throw std::runtime_error("The offscreen renderer was deleted together with its application, create a new one using init_offscreen_renderer");
+  }
+  return renderer;
+}
+
+void OffscreenRenderer::set_size(int width, int height)
+{
+  if(width <= 0 || height <= 0)
+  {
+    throw std::runtime_error("Offscreen renderer size must be positive");
+  }
+  if(width == m_width && height == m_height)
+  {
+    return;
+  }
+
+  m_width = width;
+  m_height = height;
+  m_window->setGeometry(0, 0, m_width, m_height);
+  if(m_root_item != nullptr)
+  {
+    m_root_item->setSize(QSizeF(m_width, m_height));
+  }
+  create_fbo();
+}
+
+void OffscreenRenderer::load(const QString& path, cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> properties)
+{
+  if(property_names.size() != properties.size())
+  {
+    throw std::runtime_error("Property names and properties arrays sizes dont't match");
+  }
+
+  // The component is compiled only for the first scene that uses it
+  QQmlComponent* comp = ApplicationManager::instance().component(path);
+
+  QQmlContext* ctx = new QQmlContext(comp->engine()->rootContext());
+  set_context_properties(ctx, property_names, properties);
+
+  QObject* obj = comp->create(ctx);
+  if(obj == nullptr)
+  {
+    delete ctx;
+    throw std::runtime_error(("Error creating QML file " + path + ":\n" + component_errors(comp)).toStdString());
+  }
+  QQuickItem* item = qobject_cast<QQuickItem*>(obj);
+  if(item == nullptr)
+  {
+    delete obj;
+    delete ctx;
+    throw std::runtime_error(("The root of offscreen QML file " + path + " must be an Item").toStdString());
+  }
+
+  delete_scene();
+  QQmlEngine::setObjectOwnership(item, QQmlEngine::CppOwnership);
+  ctx->setParent(item);
+  item->setParentItem(m_window->contentItem());
+  item->setSize(QSizeF(m_width, m_height));
+  m_root_item = item;
+}
+
+void OffscreenRenderer::render(int nb_frames, cxx_wrap::ArrayRef<uint32_t> pixels)
+{
+  if(nb_frames < 1)
+  {
+    throw std::runtime_error("At least one frame must be rendered");
+  }
+  if(pixels.size() != static_cast<std::size_t>(m_width) * m_height)
+  {
+    throw std::runtime_error("Pixel buffer size does not match the offscreen renderer size");
+  }
+
+  profiler::Scope profile_scope(profiler::Category::Render, "offscreen");
+  for(int i = 0; i != nb_frames; ++i)
+  {
+    // Run timers, bindings and asynchronous loaders, as the event loop would in between frames
+    QCoreApplication::processEvents();
+    make_current();
+    m_render_control->polishItems();
+    m_render_control->sync();
+    m_render_control->render();
+  }
+  make_current();
+  read_pixels(pixels.data());
+}
+
+void OffscreenRenderer::make_current()
+{
+  if(!m_context->makeCurrent(m_surface))
+  {
+    throw std::runtime_error("Failed to make the offscreen OpenGL context current");
+  }
+}
+
+void OffscreenRenderer::create_fbo()
+{
+  make_current();
+  delete m_fbo;
+  m_fbo = new QOpenGLFramebufferObject(QSize(m_width, m_height), QOpenGLFramebufferObject::CombinedDepthStencil);
+  if(!m_fbo->isValid())
+  {
+    delete m_fbo;
+    m_fbo = nullptr;
+    throw std::runtime_error("Failed to create a framebuffer object for offscreen rendering");
+  }
+  m_window->setRenderTarget(m_fbo);
+}
+
+void OffscreenRenderer::read_pixels(uint32_t* dest)
+{
+  QOpenGLFunctions* gl = m_context->functions();
+  m_fbo->bind();
+  gl->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  if(m_context->isOpenGLES())
+  {
+    // ES only guarantees RGBA bytes, so swap red and blue to get 0xAARRGGBB words on little-endian machines
+    gl->glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, dest);
+    const std::size_t nb_pixels = static_cast<std::size_t>(m_width) * m_height;
+    for(std::size_t i = 0; i != nb_pixels; ++i)
+    {
+      const uint32_t p = dest[i];
+      dest[i] = (p & 0xff00ff00) | ((p & 0xff) << 16) | ((p >> 16) & 0xff);
+    }
+  }
+  else
+  {
+    gl->glReadPixels(0, 0, m_width, m_height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, dest);
+  }
+  m_fbo->release();
+
+  // OpenGL rows start at the bottom
+  for(int y = 0; y != m_height / 2; ++y)
+  {
+    std::swap_ranges(dest + y*m_width, dest + (y+1)*m_width, dest + (m_height-1-y)*m_width);
+  }
+}
+
+void OffscreenRenderer::delete_scene()
+{
+  delete m_root_item.data();
+  m_root_item = nullptr;
+}
+
+} // namespace qmlwrap
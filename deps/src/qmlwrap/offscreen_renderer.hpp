@@ -0,0 +1,76 @@
+#ifndef QML_OFFSCREEN_RENDERER_H
+#define QML_OFFSCREEN_RENDERER_H
+
+#include <cxx_wrap.hpp>
+
+#include <QObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QPointer>
+#include <QSet>
+#include <QQuickItem>
+#include <QQuickRenderControl>
+#include <QQuickWindow>
+
+namespace qmlwrap
+{
+
+/// Renders QML scenes to memory without showing a window, using a QQuickRenderControl that draws into a framebuffer object.
+/// The OpenGL context, the framebuffer and the compiled QML are reused for each scene, so many images can be rendered in a loop.
+/// Renderers are deleted when their application is cleaned up, Julia accesses them through checked so a stale renderer throws instead of crashing.
+class OffscreenRenderer : public QObject
+{
+  Q_OBJECT
+public:
+  OffscreenRenderer(int width, int height, QObject* parent = 0);
+  virtual ~OffscreenRenderer();
+
+  /// Return renderer, throwing if it was already deleted
+  static OffscreenRenderer& checked(OffscreenRenderer& renderer);
+
+  int width() const
+  {
+    return m_width;
+  }
+
+  int height() const
+  {
+    return m_height;
+  }
+
+  /// Change the size of the rendered images
+  void set_size(int width, int height);
+
+  /// Replace the current scene with the root item of the given QML file, created in a new context with the given properties
+  void load(const QString& path, cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> properties);
+
+  /// Render nb_frames frames, processing pending events before each frame, and copy the last one to pixels.
+  /// pixels has one 0xAARRGGBB value per pixel, row by row starting at the top, with width*height elements.
+  void render(int nb_frames, cxx_wrap::ArrayRef<uint32_t> pixels);
+
+private:
+  /// Make the OpenGL context current, throwing if this fails
+  void make_current();
+
+  /// (Re)create the framebuffer for the current size
+  void create_fbo();
+
+  /// Copy the framebuffer to dest, flipping it so the first row is the top of the image
+  void read_pixels(uint32_t* dest);
+
+  void delete_scene();
+
+  int m_width;
+  int m_height;
+  QOpenGLContext* m_context = nullptr;
+  QOffscreenSurface* m_surface = nullptr;
+  QQuickRenderControl* m_render_control = nullptr;
+  QQuickWindow* m_window = nullptr;
+  QOpenGLFramebufferObject* m_fbo = nullptr;
+  QPointer<QQuickItem> m_root_item;
+};
+
+} // namespace qmlwrap
+
+#endif
@@ -4,6 +4,7 @@
 #include <QSGSimpleTextureNode>
 
 #include "opengl_viewport.hpp"
+#include "profiler.hpp"
 
 namespace qmlwrap
 {
@@ -22,8 +23,11 @@ public:
       m_vp->setup_buffer(m_handle, m_width, m_height);
       m_need_setup = false;
     }
-    m_vp->render();
-    m_vp->post_render();
+    {
+      profiler::Scope profile_scope(profiler::Category::Render, m_vp->metaObject()->className());
+      m_vp->render();
+      m_vp->post_render();
+    }
     m_vp->window()->resetOpenGLState();
   }
 
@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+
+#include "profiler.hpp"
+
+// Total time spent in garbage collection, in ns
+extern "C" uint64_t jl_gc_total_hrtime(void);
+
+namespace qmlwrap
+{
+
+namespace profiler
+{
+
+namespace detail
+{
+  std::atomic<int> g_flags(0);
+
+  typedef QPair<int, QByteArray> EntryKey;
+
+  /// Counters for one name in one thread. Only the owning thread increments, other threads only read and reset.
+  struct Entry
+  {
+    Entry(Category c, const QByteArray& n) : category(c), name(n)
+    {
+      for(std::atomic<uint64_t>& bucket : buckets)
+      {
+        bucket.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    const Category category;
+    const QByteArray name;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> buckets[Histogram::nb_buckets];
+    Entry* next = nullptr;
+  };
+
+  /// Entries of one thread. New entries are published by pushing on a linked list, so readers never block the owner.
+  struct ThreadTable
+  {
+    QHash<EntryKey, Entry*> lookup; // Only accessed by the owning thread
+    std::atomic<Entry*> head{nullptr};
+  };
+
+  // Tables are never deleted, so they remain readable after their thread exits
+  QMutex g_tables_mutex;
+  std::vector<ThreadTable*> g_tables;
+  thread_local ThreadTable* t_table = nullptr;
+
+  ThreadTable& thread_table()
+  {
+    if(t_table == nullptr)
+    {
+      t_table = new ThreadTable();
+      QMutexLocker lock(&g_tables_mutex);
+      g_tables.push_back(t_table);
+    }
+    return *t_table;
+  }
+
+  Entry& entry(Category category, const QByteArray& name)
+  {
+    ThreadTable& table = thread_table();
+    const EntryKey key(static_cast<int>(category), name);
+    auto it = table.lookup.find(key);
+    if(it != table.lookup.end())
+    {
+      return **it;
+    }
+
+    Entry* new_entry = new Entry(category, name);
+    new_entry->next = table.head.load(std::memory_order_relaxed);
+    table.head.store(new_entry, std::memory_order_release);
+    table.lookup.insert(key, new_entry);
+    return *new_entry;
+  }
+
+  /// Timeline event, with times in ns
+  struct TraceEvent
+  {
+    Category category;
+    QByteArray name;
+    int64_t start_ns;
+    int64_t duration_ns;
+  };
+
+  /// Ring buffer with the last events of one thread. The mutex is only contended while the trace is started or written.
+  struct ThreadTrace
+  {
+    QMutex mutex;
+    std::vector<TraceEvent> events;
+    std::size_t next = 0;
+    int thread_index = 0;
+  };
+
+  std::vector<ThreadTrace*> g_traces;
+  std::size_t g_trace_capacity = 0;
+  int64_t g_trace_origin_ns = 0;
+  thread_local ThreadTrace* t_trace = nullptr;
+  // GC time up to which collections were added to the trace of this thread
+  thread_local uint64_t t_gc_reported_ns = 0;
+
+  int64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  ThreadTrace& thread_trace()
+  {
+    if(t_trace == nullptr)
+    {
+      t_trace = new ThreadTrace();
+      QMutexLocker lock(&g_tables_mutex);
+      t_trace->thread_index = static_cast<int>(g_traces.size());
+      t_trace->events.resize(g_trace_capacity);
+      g_traces.push_back(t_trace);
+    }
+    return *t_trace;
+  }
+
+  void add_trace_event(Category category, const QByteArray& name, int64_t start_ns, int64_t duration_ns)
+  {
+    ThreadTrace& trace = thread_trace();
+    QMutexLocker lock(&trace.mutex);
+    if(trace.events.empty())
+    {
+      return;
+    }
+    TraceEvent& e = trace.events[trace.next % trace.events.size()];
+    e.category = category;
+    e.name = name;
+    e.start_ns = start_ns;
+    e.duration_ns = duration_ns;
+    ++trace.next;
+  }
+
+  void write_json_string(QFile& out, const QByteArray& str)
+  {
+    out.putChar('"');
+    for(const char c : str)
+    {
+      if(c == '"' || c == '\\')
+      {
+        out.putChar('\\');
+        out.putChar(c);
+      }
+      else if(static_cast<unsigned char>(c) < 0x20)
+      {
+        out.write(QByteArray("\\u00") + QByteArray::number(static_cast<int>(c), 16).rightJustified(2, '0'));
+      }
+      else
+      {
+        out.putChar(c);
+      }
+    }
+    out.putChar('"');
+  }
+
+  template<typename FunctorT>
+  void for_each_entry(FunctorT f)
+  {
+    QMutexLocker lock(&g_tables_mutex);
+    for(ThreadTable* table : g_tables)
+    {
+      for(Entry* e = table->head.load(std::memory_order_acquire); e != nullptr; e = e->next)
+      {
+        f(*e);
+      }
+    }
+  }
+}
+
+const char* category_name(Category category)
+{
+  switch(category)
+  {
+    case Category::Call:
+      return "call";
+    case Category::RoleGet:
+      return "role_get";
+    case Category::RoleSet:
+      return "role_set";
+    case Category::Signal:
+      return "signal";
+    case Category::Property:
+      return "property";
+    case Category::Paint:
+      return "paint";
+    case Category::Render:
+      return "render";
+    case Category::Events:
+      return "events";
+    case Category::GC:
+      return "gc";
+  }
+  return "unknown";
+}
+
+int Histogram::bucket_index(uint64_t ns)
+{
+  if(ns < nb_linear)
+  {
+    return static_cast<int>(ns);
+  }
+
+  int exponent = 4;
+  while(exponent != 63 && (ns >> (exponent + 1)) != 0)
+  {
+    ++exponent;
+  }
+  if(exponent > max_exponent)
+  {
+    return nb_buckets - 1;
+  }
+  const int sub_bucket = static_cast<int>(ns >> (exponent - 3)) & (nb_sub_buckets - 1);
+  return nb_linear + (exponent - 4) * nb_sub_buckets + sub_bucket;
+}
+
+uint64_t Histogram::bucket_limit(int index)
+{
+  if(index < nb_linear)
+  {
+    return static_cast<uint64_t>(index);
+  }
+
+  const int exponent = 4 + (index - nb_linear) / nb_sub_buckets;
+  const uint64_t sub_bucket = (index - nb_linear) % nb_sub_buckets;
+  return ((nb_sub_buckets + sub_bucket + 1) << (exponent - 3)) - 1;
+}
+
+uint64_t Histogram::percentile(double fraction) const
+{
+  if(count == 0)
+  {
+    return 0;
+  }
+
+  const uint64_t rank = std::max(uint64_t(1), static_cast<uint64_t>(fraction * count + 0.5));
+  uint64_t nb_seen = 0;
+  for(int i = 0; i != nb_buckets; ++i)
+  {
+    nb_seen += buckets[i];
+    if(nb_seen >= rank)
+    {
+      return std::min(bucket_limit(i), max_ns);
+    }
+  }
+  return max_ns;
+}
+
+void set_enabled(bool enable)
+{
+  if(enable)
+  {
+    detail::g_flags.fetch_or(detail::profiling_flag, std::memory_order_relaxed);
+  }
+  else
+  {
+    detail::g_flags.fetch_and(~detail::profiling_flag, std::memory_order_relaxed);
+  }
+}
+
+void record(Category category, const QByteArray& name, uint64_t ns)
+{
+  detail::Entry& e = detail::entry(category, name);
+  e.count.fetch_add(1, std::memory_order_relaxed);
+  e.total_ns.fetch_add(ns, std::memory_order_relaxed);
+  if(ns > e.max_ns.load(std::memory_order_relaxed))
+  {
+    e.max_ns.store(ns, std::memory_order_relaxed);
+  }
+  e.buckets[Histogram::bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void reset()
+{
+  detail::for_each_entry([](detail::Entry& e)
+  {
+    e.count.store(0, std::memory_order_relaxed);
+    e.total_ns.store(0, std::memory_order_relaxed);
+    e.max_ns.store(0, std::memory_order_relaxed);
+    for(std::atomic<uint64_t>& bucket : e.buckets)
+    {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  });
+}
+
+void report(const std::function<void(Category, const QByteArray&, const Histogram&)>& f)
+{
+  QMap<detail::EntryKey, Histogram> merged;
+  detail::for_each_entry([&merged](detail::Entry& e)
+  {
+    const uint64_t count = e.count.load(std::memory_order_relaxed);
+    if(count == 0)
+    {
+      return;
+    }
+    Histogram& h = merged[detail::EntryKey(static_cast<int>(e.category), e.name)];
+    h.count += count;
+    h.total_ns += e.total_ns.load(std::memory_order_relaxed);
+    h.max_ns = std::max(h.max_ns, e.max_ns.load(std::memory_order_relaxed));
+    for(int i = 0; i != Histogram::nb_buckets; ++i)
+    {
+      h.buckets[i] += e.buckets[i].load(std::memory_order_relaxed);
+    }
+  });
+
+  for(auto it = merged.begin(); it != merged.end(); ++it)
+  {
+    f(static_cast<Category>(it.key().first), it.key().second, it.value());
+  }
+}
+
+void start_tracing(int capacity)
+{
+  if(capacity <= 0)
+  {
+    throw std::runtime_error("Trace capacity must be positive, got " + std::to_string(capacity));
+  }
+
+  {
+    QMutexLocker lock(&detail::g_tables_mutex);
+    detail::g_trace_capacity = capacity;
+    detail::g_trace_origin_ns = detail::now_ns();
+    for(detail::ThreadTrace* trace : detail::g_traces)
+    {
+      QMutexLocker trace_lock(&trace->mutex);
+      trace->events.assign(capacity, detail::TraceEvent());
+      trace->next = 0;
+    }
+  }
+  detail::g_flags.fetch_or(detail::tracing_flag, std::memory_order_relaxed);
+}
+
+void stop_tracing()
+{
+  detail::g_flags.fetch_and(~detail::tracing_flag, std::memory_order_relaxed);
+}
+
+int write_trace(const QString& path)
+{
+  QFile out(path);
+  if(!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    throw std::runtime_error("Failed to open trace file " + path.toStdString() + " for writing: " + out.errorString().toStdString());
+  }
+
+  int nb_events = 0;
+  out.write("{\"traceEvents\":[\n");
+  QMutexLocker lock(&detail::g_tables_mutex);
+  for(detail::ThreadTrace* trace : detail::g_traces)
+  {
+    QMutexLocker trace_lock(&trace->mutex);
+    const QByteArray tid = QByteArray::number(trace->thread_index);
+    if(nb_events != 0)
+    {
+      out.write(",\n");
+    }
+    out.write("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":\"thread " + tid + "\"}}");
+    ++nb_events;
+
+    // Oldest event first, starting after the most recent one if the buffer wrapped around
+    const std::size_t capacity = trace->events.size();
+    const std::size_t nb_stored = std::min(trace->next, capacity);
+    const std::size_t first = trace->next - nb_stored;
+    for(std::size_t i = first; i != trace->next; ++i)
+    {
+      const detail::TraceEvent& e = trace->events[i % capacity];
+      out.write(",\n{\"name\":");
+      detail::write_json_string(out, e.name);
+      out.write(",\"cat\":\"" + QByteArray(category_name(e.category)) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid);
+      out.write(",\"ts\":" + QByteArray::number((e.start_ns - detail::g_trace_origin_ns) / 1000., 'f', 3));
+      out.write(",\"dur\":" + QByteArray::number(e.duration_ns / 1000., 'f', 3) + "}");
+      ++nb_events;
+    }
+  }
+  out.write("\n]}\n");
+  return nb_events;
+}
+
+void Scope::start()
+{
+  if(m_flags & detail::tracing_flag)
+  {
+    m_gc_start_ns = jl_gc_total_hrtime();
+  }
+  m_start_ns = detail::now_ns();
+}
+
+void Scope::finish()
+{
+  const int64_t end_ns = detail::now_ns();
+  if(m_flags & detail::profiling_flag)
+  {
+    record(m_category, m_name, end_ns - m_start_ns);
+  }
+  if(m_flags & detail::tracing_flag)
+  {
+    detail::add_trace_event(m_category, m_name, m_start_ns, end_ns - m_start_ns);
+    // Collections are only known by their total time, so they are shown at the end of the scope in which they ran.
+    // Time already reported by a nested scope is skipped.
+    const uint64_t gc_total_ns = jl_gc_total_hrtime();
+    const uint64_t gc_start_ns = std::max(m_gc_start_ns, detail::t_gc_reported_ns);
+    if(gc_total_ns > gc_start_ns)
+    {
+      static const QByteArray gc_name("GC");
+      const int64_t gc_ns = static_cast<int64_t>(gc_total_ns - gc_start_ns);
+      detail::add_trace_event(Category::GC, gc_name, end_ns - gc_ns, gc_ns);
+      detail::t_gc_reported_ns = gc_total_ns;
+    }
+  }
+}
+
+} // namespace profiler
+
+} // namespace qmlwrap
@@ -0,0 +1,158 @@
+#ifndef QML_PROFILER_H
+#define QML_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include <QByteArray>
+#include <QString>
+
+namespace qmlwrap
+{
+
+/// Optional instrumentation of the crossings between Qt and Julia, keeping call counts and latency histograms or a timeline per thread
+namespace profiler
+{
+
+/// Kind of boundary crossing that is measured
+enum class Category
+{
+  Call,     // JuliaAPI call of a Julia function
+  RoleGet,  // ListModel role read
+  RoleSet,  // ListModel role write
+  Signal,   // Signal emitted from Julia
+  Property, // JuliaObject property written from QML
+  Paint,    // JuliaPaintedItem paint callback
+  Render,   // OpenGLViewport render callback
+  Events,   // Qt event processing from the Julia event loop
+  GC        // Julia garbage collection, only traced
+};
+
+const char* category_name(Category category);
+
+/// Log-linear latency histogram: exact below 16 ns, then 8 buckets per power of two, i.e. a relative error below 12.5 %
+struct Histogram
+{
+  static const int nb_linear = 16;
+  static const int nb_sub_buckets = 8;
+  static const int max_exponent = 40; // about 18 minutes
+  static const int nb_buckets = nb_linear + (max_exponent - 3) * nb_sub_buckets;
+
+  static int bucket_index(uint64_t ns);
+  /// Upper bound in ns of the values in the given bucket
+  static uint64_t bucket_limit(int index);
+
+  /// Value in ns below which the given fraction of the samples lies
+  uint64_t percentile(double fraction) const;
+
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+  uint64_t buckets[nb_buckets] = {};
+};
+
+namespace detail
+{
+  // Bits of g_flags
+  const int profiling_flag = 1;
+  const int tracing_flag = 2;
+  extern std::atomic<int> g_flags;
+}
+
+/// True if profiling or tracing is on. Only this relaxed load is done by the instrumented code when both are off.
+inline bool active()
+{
+  return detail::g_flags.load(std::memory_order_relaxed) != 0;
+}
+
+/// True if call counts and histograms are recorded
+inline bool enabled()
+{
+  return (detail::g_flags.load(std::memory_order_relaxed) & detail::profiling_flag) != 0;
+}
+
+void set_enabled(bool enable);
+
+/// Add a measurement for the calling thread
+void record(Category category, const QByteArray& name, uint64_t ns);
+
+/// Zero all counters of all threads
+void reset();
+
+/// Call f for each measured name, with the histograms of all threads merged
+void report(const std::function<void(Category, const QByteArray&, const Histogram&)>& f);
+
+/// Start recording a timeline, keeping the last capacity events of each thread
+void start_tracing(int capacity);
+
+/// Stop recording the timeline. Recorded events are kept until the next start_tracing.
+void stop_tracing();
+
+/// True if timeline events are recorded
+inline bool tracing()
+{
+  return (detail::g_flags.load(std::memory_order_relaxed) & detail::tracing_flag) != 0;
+}
+
+/// Write the recorded timeline to path in the Chrome trace event JSON format, returning the number of events
+int write_trace(const QString& path);
+
+/// Measures the lifetime of the object, if profiling or tracing is on when it is constructed
+class Scope
+{
+public:
+  Scope(Category category, const char* name) : m_category(category), m_flags(detail::g_flags.load(std::memory_order_relaxed))
+  {
+    if(m_flags != 0)
+    {
+      m_name = QByteArray(name);
+      start();
+    }
+  }
+
+  Scope(Category category, const QByteArray& name) : m_category(category), m_flags(detail::g_flags.load(std::memory_order_relaxed))
+  {
+    if(m_flags != 0)
+    {
+      m_name = name;
+      start();
+    }
+  }
+
+  Scope(Category category, const QString& name) : m_category(category), m_flags(detail::g_flags.load(std::memory_order_relaxed))
+  {
+    if(m_flags != 0)
+    {
+      m_name = name.toUtf8();
+      start();
+    }
+  }
+
+  ~Scope()
+  {
+    if(m_flags != 0)
+    {
+      finish();
+    }
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  void start();
+  void finish();
+
+  const Category m_category;
+  const int m_flags;
+  QByteArray m_name;
+  int64_t m_start_ns = 0;
+  uint64_t m_gc_start_ns = 0;
+};
+
+} // namespace profiler
+
+} // namespace qmlwrap
+
+#endif
@@ -1,3 +1,6 @@
+#include <cmath>
+#include <limits>
+
 #include <QDebug>
 #include <QFileInfo>
 #include <QUrl>
@@ -128,8 +131,12 @@ QVariant ConvertToCpp<QVariant, false, false, false>::operator()(jl_value_t* jul
 {
   if(jl_is_array(julia_value))
   {
-    cxx_wrap::ArrayRef<jl_value_t*> arr_ref((jl_array_t*)julia_value);
     QVariantList result;
+    if(qmlwrap::detail::try_convert_array_to_qt<double, float, int32_t, int64_t, uint32_t, uint64_t>((jl_array_t*)julia_value, result))
+    {
+      return result;
+    }
+    cxx_wrap::ArrayRef<jl_value_t*> arr_ref((jl_array_t*)julia_value);
     for(jl_value_t* val : arr_ref)
     {
       result.push_back(cxx_wrap::convert_to_cpp<QVariant>(val));
@@ -156,6 +163,51 @@ jl_value_t* ConvertToJulia<QVariant, false, false, false>::operator()(const QVar
   return qmlwrap::detail::try_convert_to_julia<bool, float, double, int32_t, int64_t, uint32_t, uint64_t, QString, QObject*, QVariantMap, void*>(v);
 }
 
+jl_value_t* ConvertToJulia<QJSValue, false, false, false>::operator()(const QJSValue& v) const
+{
+  if(v.isBool())
+  {
+    return jl_box_bool(v.toBool());
+  }
+  if(v.isNumber())
+  {
+    // Integral numbers become Int32, as they do when QML converts them to QVariant
+    const double d = v.toNumber();
+    if(d == std::floor(d) && d >= std::numeric_limits<int32_t>::min() && d <= std::numeric_limits<int32_t>::max())
+    {
+      return jl_box_int32(static_cast<int32_t>(d));
+    }
+    return jl_box_float64(d);
+  }
+  if(v.isString())
+  {
+    return cxx_wrap::convert_to_julia(v.toString());
+  }
+  if(v.isQObject())
+  {
+    return qmlwrap::detail::try_qobject_cast<qmlwrap::JuliaObject, qmlwrap::JuliaDisplay, qmlwrap::ListModel>(v.toQObject());
+  }
+  if(v.isArray())
+  {
+    const quint32 nb_elems = v.property("length").toUInt();
+    cxx_wrap::Array<jl_value_t*> arr;
+    JL_GC_PUSH1(arr.gc_pointer());
+    for(quint32 i = 0; i != nb_elems; ++i)
+    {
+      arr.push_back(cxx_wrap::convert_to_julia(v.property(i)));
+    }
+    JL_GC_POP();
+    return (jl_value_t*)(arr.wrapped());
+  }
+  if(v.isNull() || v.isUndefined())
+  {
+    return nullptr;
+  }
+
+  // Other objects, e.g. a map or a date
+  return cxx_wrap::convert_to_julia(v.toVariant());
+}
+
 jl_value_t* ConvertToJulia<QString, false, false, false>::operator()(const QString& str) const
 {
   return jl_cstr_to_string(str.toStdString().c_str());
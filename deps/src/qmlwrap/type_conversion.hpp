@@ -4,6 +4,8 @@
 #include <cxx_wrap.hpp>
 #include <functions.hpp>
 
+#include <QJSValue>
+#include <QList>
 #include <QString>
 #include <QVariant>
 
@@ -33,6 +35,20 @@ template<> struct static_type_mapping<QVariant>
   static jl_datatype_t* julia_type() { return jl_any_type; }
 };
 
+// Direct conversion from JS values, bypassing QVariant
+template<> struct IsValueType<QJSValue> : std::true_type {};
+template<> struct static_type_mapping<QJSValue>
+{
+  typedef jl_value_t* type;
+  static jl_datatype_t* julia_type() { return jl_any_type; }
+};
+
+template<>
+struct ConvertToJulia<QJSValue, false, false, false>
+{
+  jl_value_t* operator()(const QJSValue& v) const;
+};
+
 // Treat QString specially to make conversion transparent
 template<> struct IsValueType<QString> : std::true_type {};
 template<> struct static_type_mapping<QString>
@@ -75,5 +91,69 @@ struct ConvertToCpp<QUrl, false, false, false>
 
 } // namespace cxx_wrap
 
+namespace qmlwrap
+{
+
+namespace detail
+{
+
+// Conversion of one array element to the element type of the Qt list
+template<typename ElementT>
+struct ArrayElementToQt
+{
+  template<typename CppT>
+  ElementT operator()(const CppT& x) const
+  {
+    return static_cast<ElementT>(x);
+  }
+};
+
+// QVariant elements keep the exact C++ type
+template<>
+struct ArrayElementToQt<QVariant>
+{
+  template<typename CppT>
+  QVariant operator()(const CppT& x) const
+  {
+    return QVariant::fromValue(x);
+  }
+};
+
+// Bulk conversion of an array with elements of type CppT to a Qt list such as QVariantList or QList<qreal>, reading the array data directly
+template<typename CppT, typename ListT>
+bool convert_array_to_qt(jl_array_t* arr, ListT& result)
+{
+  if(jl_array_eltype((jl_value_t*)arr) != (jl_value_t*)cxx_wrap::julia_type<CppT>())
+  {
+    return false;
+  }
+
+  ArrayElementToQt<typename ListT::value_type> convert_element;
+  const CppT* data = static_cast<const CppT*>(jl_array_data(arr));
+  const int nb_elems = jl_array_len(arr);
+  result.reserve(nb_elems);
+  for(int i = 0; i != nb_elems; ++i)
+  {
+    result.push_back(convert_element(data[i]));
+  }
+  return true;
+}
+
+// Try bulk conversion for a list of element types
+template<typename... TypesT, typename ListT>
+bool try_convert_array_to_qt(jl_array_t* arr, ListT& result)
+{
+  for(bool converted : {convert_array_to_qt<TypesT>(arr, result)...})
+  {
+    if(converted)
+      return true;
+  }
+
+  return false;
+}
+
+} // namespace detail
+} // namespace qmlwrap
+
 
 #endif
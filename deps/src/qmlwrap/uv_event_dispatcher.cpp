@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <vector>
+
+#include <poll.h>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QSocketNotifier>
+#include <QTimerEvent>
+#include <qpa/qwindowsysteminterface.h>
+
+#include "profiler.hpp"
+#include "uv_event_dispatcher.hpp"
+
+// Number of posted events waiting in all threads, exported by QtCore for the event dispatchers
+Q_CORE_EXPORT uint qGlobalPostedEventsCount();
+
+namespace qmlwrap
+{
+
+namespace detail
+{
+  // Maximum wait in nested event loops, which can't be woken up by the libuv async handle
+  const int nested_wait_ms = 5;
+}
+
+UvEventDispatcher::UvEventDispatcher(uv_loop_t* loop, QObject* parent) : QAbstractEventDispatcher(parent), m_loop(loop), m_wakeup(new uv_async_t()), m_interrupted(false)
+{
+  uv_async_init(m_loop, m_wakeup, UvEventDispatcher::on_wakeup);
+  m_wakeup->data = this;
+}
+
+UvEventDispatcher::~UvEventDispatcher()
+{
+  for(TimerHandle* timer : m_timers)
+  {
+    close_timer(timer);
+  }
+  m_timers.clear();
+
+  for(SocketHandle* socket : m_sockets)
+  {
+    uv_poll_stop(&socket->uv_poll);
+    uv_close((uv_handle_t*)&socket->uv_poll, UvEventDispatcher::on_poll_closed);
+  }
+  m_sockets.clear();
+
+  uv_close((uv_handle_t*)m_wakeup, UvEventDispatcher::on_wakeup_closed);
+}
+
+bool UvEventDispatcher::processEvents(QEventLoop::ProcessEventsFlags flags)
+{
+  ProcessScope process_scope(this);
+  m_interrupted.store(false);
+  emit awake();
+
+  const int nb_activations_before = m_nb_activations;
+  // Events may have been found while an event handler waited in Julia
+  bool had_events = deliver_deferred_events();
+  had_events = send_queued_events(flags) || had_events;
+  if(m_interrupted.load())
+  {
+    return had_events;
+  }
+
+  const bool wait = (flags & QEventLoop::WaitForMoreEvents) && !had_events && !has_deferred_events();
+  if(wait)
+  {
+    emit aboutToBlock();
+  }
+
+  if(m_callback_depth == 0)
+  {
+    // The callbacks only record timers, socket notifiers and wakeups, which are delivered once libuv returned
+    if(wait)
+    {
+      jl_run_once(m_loop);
+      emit awake();
+    }
+    else
+    {
+      jl_process_events(m_loop);
+    }
+    deliver_deferred_events();
+  }
+  else
+  {
+    process_nested(wait);
+  }
+
+  return had_events || m_nb_activations != nb_activations_before;
+}
+
+bool UvEventDispatcher::hasPendingEvents()
+{
+  return has_deferred_events() || qGlobalPostedEventsCount() > 0 || QWindowSystemInterface::windowSystemEventsQueued() > 0;
+}
+
+void UvEventDispatcher::registerSocketNotifier(QSocketNotifier* notifier)
+{
+  const int fd = notifier->socket();
+  SocketHandle* socket = m_sockets.value(fd, nullptr);
+  if(socket == nullptr)
+  {
+    socket = new SocketHandle();
+    socket->dispatcher = this;
+    socket->fd = fd;
+    std::fill(socket->notifiers, socket->notifiers + 3, nullptr);
+    if(uv_poll_init(m_loop, &socket->uv_poll, fd) != 0)
+    {
+      qWarning() << "Failed to watch socket " << fd << " in the Julia event loop";
+      delete socket;
+      return;
+    }
+    socket->uv_poll.data = socket;
+    m_sockets[fd] = socket;
+  }
+
+  if(notifier->type() == QSocketNotifier::Exception)
+  {
+    qWarning() << "Exception socket notifiers are not supported by the Julia event loop, socket " << fd << " will not report exceptions";
+  }
+  socket->notifiers[notifier->type()] = notifier;
+  update_poll(socket);
+}
+
+void UvEventDispatcher::unregisterSocketNotifier(QSocketNotifier* notifier)
+{
+  SocketHandle* socket = m_sockets.value(notifier->socket(), nullptr);
+  if(socket == nullptr || socket->notifiers[notifier->type()] != notifier)
+  {
+    return;
+  }
+  socket->notifiers[notifier->type()] = nullptr;
+  update_poll(socket);
+}
+
+void UvEventDispatcher::registerTimer(int timer_id, int interval, Qt::TimerType timer_type, QObject* object)
+{
+  TimerHandle* timer = new TimerHandle();
+  timer->dispatcher = this;
+  timer->id = timer_id;
+  timer->interval = interval;
+  timer->type = timer_type;
+  timer->object = object;
+  timer->due = clock::now() + std::chrono::milliseconds(interval);
+  timer->deferred = false;
+  uv_timer_init(m_loop, &timer->uv_timer);
+  timer->uv_timer.data = timer;
+  // A zero interval means firing at every loop iteration, which libuv only does with a non-zero repeat
+  uv_timer_start(&timer->uv_timer, UvEventDispatcher::on_timer, interval, std::max(interval, 1));
+  m_timers[timer_id] = timer;
+}
+
+bool UvEventDispatcher::unregisterTimer(int timer_id)
+{
+  TimerHandle* timer = m_timers.take(timer_id);
+  if(timer == nullptr)
+  {
+    return false;
+  }
+  close_timer(timer);
+  return true;
+}
+
+bool UvEventDispatcher::unregisterTimers(QObject* object)
+{
+  bool found = false;
+  for(auto it = m_timers.begin(); it != m_timers.end();)
+  {
+    if(it.value()->object == object)
+    {
+      close_timer(it.value());
+      it = m_timers.erase(it);
+      found = true;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  return found;
+}
+
+QList<QAbstractEventDispatcher::TimerInfo> UvEventDispatcher::registeredTimers(QObject* object) const
+{
+  QList<TimerInfo> result;
+  for(const TimerHandle* timer : m_timers)
+  {
+    if(timer->object == object)
+    {
+      result.push_back(TimerInfo(timer->id, timer->interval, timer->type));
+    }
+  }
+  return result;
+}
+
+int UvEventDispatcher::remainingTime(int timer_id)
+{
+  const TimerHandle* timer = m_timers.value(timer_id, nullptr);
+  if(timer == nullptr)
+  {
+    return -1;
+  }
+  const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(timer->due - clock::now()).count();
+  return std::max(0, static_cast<int>(remaining));
+}
+
+void UvEventDispatcher::wakeUp()
+{
+  uv_async_send(m_wakeup);
+}
+
+void UvEventDispatcher::interrupt()
+{
+  m_interrupted.store(true);
+  wakeUp();
+}
+
+void UvEventDispatcher::flush()
+{
+  // Called by QCoreApplication::flush, e.g. before a blocking operation, so everything queued so far is delivered
+  send_queued_events(QEventLoop::AllEvents);
+}
+
+void UvEventDispatcher::on_timer(uv_timer_t* handle)
+{
+  TimerHandle* timer = static_cast<TimerHandle*>(handle->data);
+  UvEventDispatcher* dispatcher = timer->dispatcher;
+  if(dispatcher->defer_events())
+  {
+    if(!timer->deferred)
+    {
+      timer->deferred = true;
+      dispatcher->m_deferred_timers.push_back(timer->id);
+    }
+    return;
+  }
+  CallbackScope scope(dispatcher);
+  dispatcher->activate_timer(timer->id);
+}
+
+void UvEventDispatcher::on_poll(uv_poll_t* handle, int status, int events)
+{
+  SocketHandle* socket = static_cast<SocketHandle*>(handle->data);
+  UvEventDispatcher* dispatcher = socket->dispatcher;
+  // On error, activate all notifiers so the owner gets to see the error when reading or writing
+  const int activated_events = status < 0 ? (UV_READABLE | UV_WRITABLE) : events;
+  if(dispatcher->defer_events())
+  {
+    dispatcher->m_deferred_sockets[socket->fd] |= activated_events;
+    return;
+  }
+  CallbackScope scope(dispatcher);
+  dispatcher->activate_socket(socket->fd, activated_events);
+}
+
+void UvEventDispatcher::on_wakeup(uv_async_t* handle)
+{
+  UvEventDispatcher* dispatcher = static_cast<UvEventDispatcher*>(handle->data);
+  if(dispatcher->defer_events())
+  {
+    dispatcher->m_deferred_wakeup = true;
+    return;
+  }
+  CallbackScope scope(dispatcher);
+  ++dispatcher->m_nb_activations;
+  profiler::Scope profile_scope(profiler::Category::Events, "posted_events");
+  dispatcher->send_queued_events(QEventLoop::AllEvents);
+}
+
+void UvEventDispatcher::on_timer_closed(uv_handle_t* handle)
+{
+  delete static_cast<TimerHandle*>(handle->data);
+}
+
+void UvEventDispatcher::on_poll_closed(uv_handle_t* handle)
+{
+  delete static_cast<SocketHandle*>(handle->data);
+}
+
+void UvEventDispatcher::on_wakeup_closed(uv_handle_t* handle)
+{
+  delete (uv_async_t*)handle;
+}
+
+bool UvEventDispatcher::send_queued_events(QEventLoop::ProcessEventsFlags flags)
+{
+  const bool had_posted_events = qGlobalPostedEventsCount() > 0;
+  QCoreApplication::sendPostedEvents();
+  const bool had_window_events = QWindowSystemInterface::sendWindowSystemEvents(flags);
+  return had_posted_events || had_window_events;
+}
+
+bool UvEventDispatcher::deliver_deferred_events()
+{
+  if(!has_deferred_events())
+  {
+    return false;
+  }
+
+  // Taken out first, since the event handlers may let Julia run libuv and record new events
+  QList<int> timer_ids;
+  timer_ids.swap(m_deferred_timers);
+  QHash<int, int> socket_events;
+  socket_events.swap(m_deferred_sockets);
+  const bool wakeup = m_deferred_wakeup;
+  m_deferred_wakeup = false;
+
+  for(const int timer_id : timer_ids)
+  {
+    TimerHandle* timer = m_timers.value(timer_id, nullptr);
+    if(timer != nullptr && timer->deferred)
+    {
+      timer->deferred = false;
+      activate_timer(timer_id);
+    }
+  }
+  for(auto it = socket_events.constBegin(); it != socket_events.constEnd(); ++it)
+  {
+    activate_socket(it.key(), it.value());
+  }
+  if(wakeup)
+  {
+    ++m_nb_activations;
+    profiler::Scope profile_scope(profiler::Category::Events, "posted_events");
+    send_queued_events(QEventLoop::AllEvents);
+  }
+  return true;
+}
+
+void UvEventDispatcher::activate_timer(int timer_id)
+{
+  TimerHandle* timer = m_timers.value(timer_id, nullptr);
+  if(timer == nullptr)
+  {
+    return;
+  }
+
+  ++m_nb_activations;
+  profiler::Scope profile_scope(profiler::Category::Events, "timer");
+  timer->due = clock::now() + std::chrono::milliseconds(timer->interval);
+  // The timer may be unregistered by the event handler, so nothing can be accessed after sending
+  QTimerEvent e(timer_id);
+  QCoreApplication::sendEvent(timer->object, &e);
+}
+
+void UvEventDispatcher::activate_socket(int fd, int events)
+{
+  ++m_nb_activations;
+  profiler::Scope profile_scope(profiler::Category::Events, "socket");
+  const QSocketNotifier::Type types[2] = {QSocketNotifier::Read, QSocketNotifier::Write};
+  const int uv_events[2] = {UV_READABLE, UV_WRITABLE};
+  for(int i = 0; i != 2; ++i)
+  {
+    if(!(events & uv_events[i]))
+    {
+      continue;
+    }
+    // Look up again each time, since the first event handler may have unregistered the notifiers
+    SocketHandle* socket = m_sockets.value(fd, nullptr);
+    if(socket == nullptr || socket->notifiers[types[i]] == nullptr)
+    {
+      continue;
+    }
+    QEvent e(QEvent::SockAct);
+    QCoreApplication::sendEvent(socket->notifiers[types[i]], &e);
+  }
+}
+
+void UvEventDispatcher::update_poll(SocketHandle* socket)
+{
+  int events = 0;
+  if(socket->notifiers[QSocketNotifier::Read] != nullptr && socket->notifiers[QSocketNotifier::Read]->isEnabled())
+  {
+    events |= UV_READABLE;
+  }
+  if(socket->notifiers[QSocketNotifier::Write] != nullptr && socket->notifiers[QSocketNotifier::Write]->isEnabled())
+  {
+    events |= UV_WRITABLE;
+  }
+
+  if(std::all_of(socket->notifiers, socket->notifiers + 3, [](QSocketNotifier* n) { return n == nullptr; }))
+  {
+    m_sockets.remove(socket->fd);
+    uv_poll_stop(&socket->uv_poll);
+    uv_close((uv_handle_t*)&socket->uv_poll, UvEventDispatcher::on_poll_closed);
+    return;
+  }
+
+  if(events == 0)
+  {
+    uv_poll_stop(&socket->uv_poll);
+  }
+  else
+  {
+    uv_poll_start(&socket->uv_poll, events, UvEventDispatcher::on_poll);
+  }
+}
+
+void UvEventDispatcher::close_timer(TimerHandle* timer)
+{
+  // The id may be reused by a new timer, which must not fire for this one
+  if(timer->deferred)
+  {
+    m_deferred_timers.removeAll(timer->id);
+  }
+  uv_timer_stop(&timer->uv_timer);
+  uv_close((uv_handle_t*)&timer->uv_timer, UvEventDispatcher::on_timer_closed);
+}
+
+void UvEventDispatcher::process_nested(bool wait)
+{
+  // Wait until the first timer is due, but never so long that a wakeup goes unnoticed
+  const clock::time_point now = clock::now();
+  int timeout_ms = wait ? detail::nested_wait_ms : 0;
+  for(const TimerHandle* timer : m_timers)
+  {
+    const int until_due = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(timer->due - now).count());
+    timeout_ms = std::max(0, std::min(timeout_ms, until_due));
+  }
+
+  std::vector<pollfd> poll_fds;
+  for(const SocketHandle* socket : m_sockets)
+  {
+    pollfd pfd;
+    pfd.fd = socket->fd;
+    pfd.events = 0;
+    pfd.revents = 0;
+    if(socket->notifiers[QSocketNotifier::Read] != nullptr && socket->notifiers[QSocketNotifier::Read]->isEnabled())
+    {
+      pfd.events |= POLLIN;
+    }
+    if(socket->notifiers[QSocketNotifier::Write] != nullptr && socket->notifiers[QSocketNotifier::Write]->isEnabled())
+    {
+      pfd.events |= POLLOUT;
+    }
+    if(pfd.events != 0)
+    {
+      poll_fds.push_back(pfd);
+    }
+  }
+
+  if(::poll(poll_fds.data(), poll_fds.size(), timeout_ms) > 0)
+  {
+    for(const pollfd& pfd : poll_fds)
+    {
+      const int events = ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) ? UV_READABLE : 0) | ((pfd.revents & (POLLOUT | POLLERR)) ? UV_WRITABLE : 0);
+      if(events != 0)
+      {
+        activate_socket(pfd.fd, events);
+      }
+    }
+  }
+
+  // Fire the due timers and restart their libuv handles, so they don't fire again too early
+  const clock::time_point after_poll = clock::now();
+  QList<int> due_timers;
+  for(const TimerHandle* timer : m_timers)
+  {
+    if(timer->due <= after_poll)
+    {
+      due_timers.push_back(timer->id);
+    }
+  }
+  for(const int timer_id : due_timers)
+  {
+    TimerHandle* timer = m_timers.value(timer_id, nullptr);
+    if(timer != nullptr)
+    {
+      uv_timer_start(&timer->uv_timer, UvEventDispatcher::on_timer, timer->interval, std::max(timer->interval, 1));
+      activate_timer(timer_id);
+    }
+  }
+
+  send_queued_events(QEventLoop::AllEvents);
+}
+
+} // namespace qmlwrap
@@ -0,0 +1,155 @@
+#ifndef QML_UV_EVENT_DISPATCHER_H
+#define QML_UV_EVENT_DISPATCHER_H
+
+#include <atomic>
+#include <chrono>
+
+#include <QAbstractEventDispatcher>
+#include <QHash>
+
+#include <cxx_wrap.hpp>
+
+namespace qmlwrap
+{
+
+/// Event dispatcher for the GUI thread that runs on the libuv loop of Julia, so Qt events are handled whenever Julia waits for events instead of polling.
+/// Timers and socket notifiers map to libuv handles, and posted events wake up the loop through a uv_async_t.
+/// While processEvents runs, e.g. in a blocking exec, the libuv callbacks only record what is due and the events are delivered after libuv returns,
+/// so event handlers can do I/O or wait in Julia, which runs libuv again. Otherwise, i.e. after exec_async, events are delivered from the callbacks.
+class UvEventDispatcher : public QAbstractEventDispatcher
+{
+  Q_OBJECT
+public:
+  UvEventDispatcher(uv_loop_t* loop, QObject* parent = 0);
+  virtual ~UvEventDispatcher();
+
+  virtual bool processEvents(QEventLoop::ProcessEventsFlags flags);
+  virtual bool hasPendingEvents();
+
+  virtual void registerSocketNotifier(QSocketNotifier* notifier);
+  virtual void unregisterSocketNotifier(QSocketNotifier* notifier);
+
+  virtual void registerTimer(int timer_id, int interval, Qt::TimerType timer_type, QObject* object);
+  virtual bool unregisterTimer(int timer_id);
+  virtual bool unregisterTimers(QObject* object);
+  virtual QList<TimerInfo> registeredTimers(QObject* object) const;
+  virtual int remainingTime(int timer_id);
+
+  /// Thread-safe, wakes up the libuv loop
+  virtual void wakeUp();
+  virtual void interrupt();
+  virtual void flush();
+
+private:
+  typedef std::chrono::steady_clock clock;
+
+  struct TimerHandle
+  {
+    uv_timer_t uv_timer;
+    UvEventDispatcher* dispatcher;
+    int id;
+    int interval;
+    Qt::TimerType type;
+    QObject* object;
+    clock::time_point due;
+    bool deferred; // waiting in m_deferred_timers
+  };
+
+  struct SocketHandle
+  {
+    uv_poll_t uv_poll;
+    UvEventDispatcher* dispatcher;
+    int fd;
+    QSocketNotifier* notifiers[3];
+  };
+
+  /// Counts the libuv callbacks that deliver events, since libuv can't be run again from inside a callback.
+  /// Delivering counts as waking up from the event loop, so platform plugins that flush their requests before blocking get to do so.
+  struct CallbackScope
+  {
+    CallbackScope(UvEventDispatcher* d) : dispatcher(d)
+    {
+      ++dispatcher->m_callback_depth;
+      emit dispatcher->awake();
+    }
+
+    ~CallbackScope()
+    {
+      --dispatcher->m_callback_depth;
+      emit dispatcher->aboutToBlock();
+    }
+
+    UvEventDispatcher* dispatcher;
+  };
+
+  /// Counts the running processEvents calls, during which events found by the callbacks are deferred
+  struct ProcessScope
+  {
+    ProcessScope(UvEventDispatcher* d) : dispatcher(d)
+    {
+      ++dispatcher->m_process_depth;
+    }
+
+    ~ProcessScope()
+    {
+      --dispatcher->m_process_depth;
+    }
+
+    UvEventDispatcher* dispatcher;
+  };
+
+  static void on_timer(uv_timer_t* handle);
+  static void on_poll(uv_poll_t* handle, int status, int events);
+  static void on_wakeup(uv_async_t* handle);
+  static void on_timer_closed(uv_handle_t* handle);
+  static void on_poll_closed(uv_handle_t* handle);
+  static void on_wakeup_closed(uv_handle_t* handle);
+
+  /// Send posted events and queued window system events, returning true if there were any
+  bool send_queued_events(QEventLoop::ProcessEventsFlags flags);
+
+  /// True if the callbacks must record events instead of delivering them
+  bool defer_events() const
+  {
+    return m_process_depth != 0;
+  }
+
+  /// Deliver the events recorded by the callbacks, returning true if there were any
+  bool deliver_deferred_events();
+
+  bool has_deferred_events() const
+  {
+    return !m_deferred_timers.isEmpty() || !m_deferred_sockets.isEmpty() || m_deferred_wakeup;
+  }
+
+  /// Fire a timer and schedule its next expiry
+  void activate_timer(int timer_id);
+
+  /// Send the activation event to the socket notifiers of fd for the given libuv events
+  void activate_socket(int fd, int events);
+
+  /// Start or stop polling for the events required by the notifiers of the socket, closing it if it has no notifiers left
+  void update_poll(SocketHandle* socket);
+
+  void close_timer(TimerHandle* timer);
+
+  /// Used by nested event loops that run from a libuv callback: fire due timers and poll the sockets directly
+  void process_nested(bool wait);
+
+  uv_loop_t* m_loop;
+  uv_async_t* m_wakeup;
+  QHash<int, TimerHandle*> m_timers;
+  QHash<int, SocketHandle*> m_sockets;
+  std::atomic<bool> m_interrupted;
+  int m_callback_depth = 0;
+  int m_process_depth = 0;
+  int m_nb_activations = 0;
+  // Events found by the callbacks while processEvents runs
+  QList<int> m_deferred_timers;
+  QHash<int, int> m_deferred_sockets;
+  bool m_deferred_wakeup = false;
+};
+
+} // namespace qmlwrap
+
+#endif
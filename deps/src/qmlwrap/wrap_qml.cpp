@@ -1,4 +1,4 @@
-#include <QApplication>
+#include <QGuiApplication>
 #include <QLibraryInfo>
 #include <QPainter>
 #include <QPaintDevice>
@@ -12,24 +12,47 @@
 #include <QtQml>
 
 #include "application_manager.hpp"
+#include "frame_scheduler.hpp"
+#include "gc_root_arena.hpp"
 #include "julia_api.hpp"
 #include "julia_display.hpp"
 #include "julia_object.hpp"
 #include "julia_painteditem.hpp"
 #include "julia_signals.hpp"
 #include "listmodel.hpp"
+#include "offscreen_renderer.hpp"
 #include "opengl_viewport.hpp"
 #include "glvisualize_viewport.hpp"
+#include "profiler.hpp"
 #include "type_conversion.hpp"
 
 namespace qmlwrap
 {
 
+JuliaSignals& julia_signals()
+{
+  JuliaSignals* julia_signals = JuliaAPI::instance()->juliaSignals();
+  if(julia_signals == nullptr)
+  {
+    throw std::runtime_error("No signals available");
+  }
+  return *julia_signals;
+}
+
 void load_qml_app(const QString& path, cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> context_properties)
 {
-  auto e = ApplicationManager::instance().init_qmlapplicationengine();
-  ApplicationManager::instance().add_context_properties(property_names, context_properties);
+  ApplicationManager& manager = ApplicationManager::instance();
+  if(manager.persistent())
+  {
+    // Reuses the engine and the compiled component from a previous run
+    manager.open_window(path, property_names, context_properties);
+    manager.mark_startup_phase(ApplicationManager::LoadQml);
+    return;
+  }
+  auto e = manager.init_qmlapplicationengine();
+  manager.add_context_properties(property_names, context_properties);
   e->load(path);
+  manager.mark_startup_phase(ApplicationManager::LoadQml);
 }
 
 
@@ -52,13 +75,18 @@ JULIA_CPP_MODULE_BEGIN(registry)
   qml_module.add_type<QQmlContext>("QQmlContext", julia_type<QObject>())
     .method("context_property", &QQmlContext::contextProperty);
   qml_module.method("set_context_property", qmlwrap::set_context_property);
+  qml_module.method("set_context_properties", qmlwrap::set_context_properties);
 
   qml_module.add_type<QQmlEngine>("QQmlEngine", julia_type<QObject>())
     .method("root_context", &QQmlEngine::rootContext);
 
   qml_module.add_type<QQmlApplicationEngine>("QQmlApplicationEngine", julia_type<QQmlEngine>())
     .constructor<QString>() // Construct with path to QML
-    .method("load", static_cast<void (QQmlApplicationEngine::*)(const QString&)>(&QQmlApplicationEngine::load)); // cast needed because load is overloaded
+    .method("load", [](QQmlApplicationEngine& e, const QString& path)
+    {
+      e.load(path);
+      qmlwrap::ApplicationManager::instance().mark_startup_phase(qmlwrap::ApplicationManager::LoadQml);
+    });
 
   qml_module.method("qt_prefix_path", []() { return QLibraryInfo::location(QLibraryInfo::PrefixPath); });
 
@@ -75,7 +103,11 @@ JULIA_CPP_MODULE_BEGIN(registry)
   });
 
   qml_module.add_type<QQuickView>("QQuickView", julia_type<QQuickWindow>())
-    .method("set_source", &QQuickView::setSource)
+    .method("set_source", [](QQuickView& view, const QUrl& url)
+    {
+      view.setSource(url);
+      qmlwrap::ApplicationManager::instance().mark_startup_phase(qmlwrap::ApplicationManager::LoadQml);
+    })
     .method("show", &QQuickView::show) // not exported: conflicts with Base.show
     .method("engine", &QQuickView::engine)
     .method("root_object", &QQuickView::rootObject);
@@ -115,23 +147,53 @@ JULIA_CPP_MODULE_BEGIN(registry)
   qml_module.method("exec", []() { qmlwrap::ApplicationManager::instance().exec(); });
   qml_module.method("exec_async", []() { qmlwrap::ApplicationManager::instance().exec_async(); });
 
+  // Julia work in between frames
+  qml_module.method("schedule_work", [](jl_function_t* f) { qmlwrap::ApplicationManager::instance().frame_scheduler()->enqueue(f); });
+  qml_module.method("set_frame_budget", [](double ms) { qmlwrap::ApplicationManager::instance().frame_scheduler()->set_budget(ms); });
+  qml_module.method("get_frame_scheduler_stats", [](cxx_wrap::ArrayRef<double> stats) { qmlwrap::ApplicationManager::instance().frame_scheduler()->get_stats(stats); });
+  qml_module.method("reset_frame_scheduler_stats", []() { qmlwrap::ApplicationManager::instance().frame_scheduler()->reset_stats(); });
+  qml_module.method("set_persistent", [](bool persistent) { qmlwrap::ApplicationManager::instance().set_persistent(persistent); });
+  qml_module.method("invalidate_qml_cache", []() { qmlwrap::ApplicationManager::instance().invalidate_components(QString()); });
+  qml_module.method("invalidate_qml_cache", [](const QString& path) { qmlwrap::ApplicationManager::instance().invalidate_components(path); });
+  qml_module.method("close_windows", []() { qmlwrap::ApplicationManager::instance().close_windows(); });
+  qml_module.add_type<qmlwrap::OffscreenRenderer>("OffscreenRenderer", julia_type<QObject>())
+    .method("width", [](qmlwrap::OffscreenRenderer& r) { return qmlwrap::OffscreenRenderer::checked(r).width(); })
+    .method("height", [](qmlwrap::OffscreenRenderer& r) { return qmlwrap::OffscreenRenderer::checked(r).height(); })
+    .method("set_size", [](qmlwrap::OffscreenRenderer& r, int width, int height) { qmlwrap::OffscreenRenderer::checked(r).set_size(width, height); })
+    .method("load_scene", [](qmlwrap::OffscreenRenderer& r, const QString& path, cxx_wrap::ArrayRef<jl_value_t*> property_names, cxx_wrap::ArrayRef<jl_value_t*> properties) { qmlwrap::OffscreenRenderer::checked(r).load(path, property_names, properties); })
+    .method("render_frames", [](qmlwrap::OffscreenRenderer& r, int nb_frames, cxx_wrap::ArrayRef<uint32_t> pixels) { qmlwrap::OffscreenRenderer::checked(r).render(nb_frames, pixels); });
+  qml_module.method("init_offscreen_renderer", [](int width, int height) { return qmlwrap::ApplicationManager::instance().init_offscreen_renderer(width, height); });
+  qml_module.method("precompile_qml", [](const QString& dir) { return qmlwrap::ApplicationManager::instance().precompile_qml(dir); });
+  qml_module.method("get_startup_timings", [](cxx_wrap::ArrayRef<double> timings) { qmlwrap::ApplicationManager::instance().get_startup_timings(timings); });
+
   qml_module.add_type<QTimer>("QTimer", julia_type<QObject>());
 
   qml_module.add_type<qmlwrap::JuliaObject>("JuliaObject", julia_type<QObject>())
     .method("set", &qmlwrap::JuliaObject::set) // Not exported, use @qmlset
+    .method("refresh", &qmlwrap::JuliaObject::refresh)
     .method("julia_object_value", &qmlwrap::JuliaObject::value); // Not exported, use @qmlget
 
   // Emit signals helper
   qml_module.method("emit", [](const char* signal_name, cxx_wrap::ArrayRef<jl_value_t*> args)
   {
-    using namespace qmlwrap;
-    JuliaSignals* julia_signals = JuliaAPI::instance()->juliaSignals();
-    if(julia_signals == nullptr)
+    // Emitting from a Julia thread other than the main thread is only safe through the queue
+    if(jl_threadid() != 0)
     {
-      throw std::runtime_error("No signals available");
+      qmlwrap::julia_signals().queue_signal(signal_name, args);
+      return;
     }
-    julia_signals->emit_signal(signal_name, args);
+    qmlwrap::julia_signals().emit_signal(signal_name, args);
+  });
+  qml_module.method("emit_queued", [](const char* signal_name, cxx_wrap::ArrayRef<jl_value_t*> args)
+  {
+    qmlwrap::julia_signals().queue_signal(signal_name, args);
   });
+  qml_module.method("coalesce_signal", [](const char* signal_name, double max_rate)
+  {
+    qmlwrap::julia_signals().set_max_rate(signal_name, max_rate);
+  });
+  qml_module.method("signal_delivered_count", [](const char* signal_name) { return qmlwrap::julia_signals().delivered_count(signal_name); });
+  qml_module.method("signal_dropped_count", [](const char* signal_name) { return qmlwrap::julia_signals().dropped_count(signal_name); });
 
   // Function to register a function
   qml_module.method("register_function", [](cxx_wrap::ArrayRef<jl_value_t*> args)
@@ -141,9 +203,59 @@ JULIA_CPP_MODULE_BEGIN(registry)
       qmlwrap::JuliaAPI::instance()->register_function(convert_to_cpp<QString>(arg));
     }
   });
+  qml_module.method("register_pure_function", [](cxx_wrap::ArrayRef<jl_value_t*> args)
+  {
+    for(jl_value_t* arg : args)
+    {
+      qmlwrap::JuliaAPI::instance()->register_function(convert_to_cpp<QString>(arg), true);
+    }
+  });
+  qml_module.method("flush_pure_cache", []() { qmlwrap::JuliaAPI::instance()->flush_pure_cache(); });
+  qml_module.method("flush_pure_cache", [](const QString& fname) { qmlwrap::JuliaAPI::instance()->flush_pure_cache(fname); });
+  qml_module.method("set_pure_cache_size", [](int64_t max_entries) { qmlwrap::JuliaAPI::instance()->set_pure_cache_size(static_cast<int>(max_entries)); });
+  qml_module.method("pure_cache_hits", []() { return qmlwrap::JuliaAPI::instance()->pure_cache_hits(); });
+  qml_module.method("pure_cache_misses", []() { return qmlwrap::JuliaAPI::instance()->pure_cache_misses(); });
+
+  // Asynchronous calls from QML
+  qml_module.method("async_call_finished", [](int call_id, jl_value_t* result) { qmlwrap::JuliaAPI::instance()->async_call_finished(call_id, result); });
+  qml_module.method("async_call_failed", [](int call_id, const QString& message) { qmlwrap::JuliaAPI::instance()->async_call_failed(call_id, message); });
+  qml_module.method("async_call_cancelled", [](int call_id) { return qmlwrap::JuliaAPI::instance()->async_call_cancelled(call_id); });
+  qml_module.method("set_max_async_calls", [](int max_calls) { qmlwrap::JuliaAPI::instance()->setMaxAsyncCalls(max_calls); });
+
+  // Profiling of the calls between Qt and Julia
+  qml_module.method("set_profiling", [](bool enable) { qmlwrap::profiler::set_enabled(enable); });
+  qml_module.method("profiling_enabled", []() { return qmlwrap::profiler::enabled(); });
+  qml_module.method("reset_profile", []() { qmlwrap::profiler::reset(); });
+  qml_module.method("visit_profile", [](jl_function_t* f)
+  {
+    using namespace qmlwrap::profiler;
+    cxx_wrap::JuliaFunction visitor(f);
+    report([&visitor](Category category, const QByteArray& name, const Histogram& h)
+    {
+      visitor(std::string(category_name(category)), name.toStdString(), static_cast<int64_t>(h.count), static_cast<int64_t>(h.total_ns), static_cast<int64_t>(h.max_ns),
+        static_cast<int64_t>(h.percentile(0.5)), static_cast<int64_t>(h.percentile(0.9)), static_cast<int64_t>(h.percentile(0.99)));
+    });
+  });
+
+  qml_module.method("visit_gc_roots", [](jl_function_t* f)
+  {
+    cxx_wrap::JuliaFunction visitor(f);
+    qmlwrap::GCRootArena::report([&visitor](const QString& name, int nb_live, int peak)
+    {
+      visitor(name.toStdString(), static_cast<int64_t>(nb_live), static_cast<int64_t>(peak));
+    });
+  });
+
+  qml_module.method("start_tracing", [](int64_t capacity) { qmlwrap::profiler::start_tracing(static_cast<int>(capacity)); });
+  qml_module.method("stop_tracing", []() { qmlwrap::profiler::stop_tracing(); });
+  qml_module.method("write_trace", [](const QString& path) { return qmlwrap::profiler::write_trace(path); });
 
   qml_module.add_type<qmlwrap::JuliaDisplay>("JuliaDisplay", julia_type("CppDisplay"))
-    .method("load_png", &qmlwrap::JuliaDisplay::load_png);
+    .method("load_png", &qmlwrap::JuliaDisplay::load_png)
+    .method("load_rgba", &qmlwrap::JuliaDisplay::load_rgba)
+    .method("load_rgb24", &qmlwrap::JuliaDisplay::load_rgb24)
+    .method("load_gray", &qmlwrap::JuliaDisplay::load_gray)
+    .method("display_pixel", [](qmlwrap::JuliaDisplay& d, int x, int y) { return d.pixel(x-1, y-1); }); // Not exported, 1-based
 
   qml_module.add_type<QPaintDevice>("QPaintDevice")
     .method("width", &QPaintDevice::width)
@@ -168,6 +280,6 @@ JULIA_CPP_MODULE_BEGIN(registry)
   qml_module.method("getindex", [](const QVariantMap& m, const QString& key) { return m[key]; });
 
   // Exports:
-  qml_module.export_symbols("QQmlContext", "set_context_property", "root_context", "load", "qt_prefix_path", "set_source", "engine", "QByteArray", "QQmlComponent", "set_data", "create", "QQuickItem", "content_item", "JuliaObject", "QTimer", "context_property", "emit", "JuliaDisplay", "init_application", "qmlcontext", "init_qmlapplicationengine", "init_qmlengine", "init_qquickview", "exec", "exec_async", "ListModel", "addrole", "setconstructor", "removerole", "setrole", "QVariantMap");
+  qml_module.export_symbols("QQmlContext", "set_context_property", "set_context_properties", "root_context", "load", "qt_prefix_path", "set_source", "engine", "QByteArray", "QQmlComponent", "set_data", "create", "QQuickItem", "content_item", "JuliaObject", "refresh", "QTimer", "context_property", "emit", "emit_queued", "coalesce_signal", "signal_delivered_count", "signal_dropped_count", "JuliaDisplay", "init_application", "qmlcontext", "init_qmlapplicationengine", "init_qmlengine", "init_qquickview", "exec", "exec_async", "set_persistent", "invalidate_qml_cache", "close_windows", "precompile_qml", "init_offscreen_renderer", "set_size", "schedule_work", "set_frame_budget", "reset_frame_scheduler_stats", "set_max_async_calls", "flush_pure_cache", "set_pure_cache_size", "pure_cache_hits", "pure_cache_misses", "set_profiling", "profiling_enabled", "reset_profile", "start_tracing", "stop_tracing", "write_trace", "ListModel", "addrole", "setconstructor", "removerole", "setrole", "QVariantMap");
   qml_module.export_symbols("QPainter", "device", "width", "height", "logicalDpiX", "logicalDpiY", "QQuickWindow", "effectiveDevicePixelRatio", "window", "JuliaPaintedItem");
 JULIA_CPP_MODULE_END
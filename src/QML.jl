@@ -66,6 +66,9 @@ Overloads for setting a property value based on its name for any base class
 generic_property_set(ctx::QQmlContext, key::AbstractString, value::Any) = set_context_property(ctx, key, value)
 generic_property_set(o::JuliaObject, key::AbstractString, value::Any) = set(o, key, value)
 
+# Convert to the Vector{Any} arguments of the C++ function
+set_context_properties(ctx::QQmlContext, names::AbstractVector, values::AbstractVector) = set_context_properties(ctx, Any[string(n) for n in names], Any[values...])
+
 """
 Setter version of `@qmlget`, use in the form:
 ```
@@ -86,23 +89,293 @@ macro emit(expr)
   esc(:(emit($(string(expr.args[1])), Any[$(expr.args[2:end]...)])))
 end
 
+@doc """
+Emit a signal from the GUI thread at the next iteration of the Qt event loop. This is safe to call from any thread,
+and is used automatically by `@emit` when called from a thread other than the main thread:
+```
+emit_queued("signal_name", Any[arg1, arg2])
+```
+Arguments are converted when they are queued, so composite types, which `@emit` passes as a `JuliaObject`, are not
+supported here and throw an error.
+""" emit_queued
+
+@doc """
+Throttle the signal with the given name to at most `max_rate` emissions per second. Emissions in between are collapsed,
+delivering only the latest arguments at the end of each interval. A rate of 0 disables throttling.
+""" coalesce_signal
+
+@doc "Number of emissions of a coalescing signal that were delivered to QML" signal_delivered_count
+@doc "Number of emissions of a coalescing signal that were collapsed into a later emission" signal_dropped_count
+
 """
 Register a Julia function for access from QML:
 ```
 @qmlfunction MyFunc
 ```
+Functions whose result only depends on their arguments can be registered as pure, so repeated calls with the same
+arguments are answered from a cache instead of calling Julia:
+```
+@qmlfunction pure=true format_value
+```
+"""
+macro qmlfunction(args...)
+  pure = false
+  fnames = Any[]
+  for arg in args
+    if isa(arg, Expr) && arg.head ∈ (:(=), :kw) && arg.args[1] == :pure
+      if !isa(arg.args[2], Bool)
+        error("pure must be true or false in @qmlfunction")
+      end
+      pure = arg.args[2]
+    else
+      push!(fnames, string(arg))
+    end
+  end
+  register = pure ? :(QML.register_pure_function) : :(QML.register_function)
+  esc(:($register($fnames)))
+end
+
+@doc """
+Clear the cached results of the functions registered using `@qmlfunction pure=true`. Call this when data used by these
+functions changes. Passing a function name only clears the results of that function.
+""" flush_pure_cache
+
+@doc "Set the maximum number of results kept by the cache of pure functions, 1024 by default" set_pure_cache_size
+@doc "Number of calls to pure functions that were answered from the cache" pure_cache_hits
+@doc "Number of calls to pure functions that needed a call to Julia" pure_cache_misses
+
+@doc """
+Queue a function taking no arguments, to be called in the time left in a frame after rendering. The function is called
+again in a later frame for as long as it returns `true`, so long computations can be split into small steps:
+```julia
+schedule_work(() -> (step!(simulation); !finished(simulation)))
+```
+""" schedule_work
+
+@doc "Set the maximum time in milliseconds spent on functions queued with `schedule_work` in a single frame" set_frame_budget
+@doc "Clear the statistics returned by `frame_scheduler_stats`" reset_frame_scheduler_stats
+
+"""
+Statistics of the work done using `schedule_work`, with times in milliseconds. `nb_frames` counts the frames in which work was
+waiting, `nb_deferred_frames` the ones where work was left for a later frame and `nb_overruns` the ones where the work took longer
+than the time left until the next frame.
+"""
+immutable FrameSchedulerStats
+  frame_interval_ms::Float64
+  budget_ms::Float64
+  nb_frames::Int
+  nb_items_run::Int
+  nb_deferred_frames::Int
+  nb_overruns::Int
+  mean_used_ms::Float64
+  max_used_ms::Float64
+  last_used_ms::Float64
+end
+
+"""
+Get the `FrameSchedulerStats` for the functions queued using `schedule_work`
+"""
+function frame_scheduler_stats()
+  stats = zeros(nfields(FrameSchedulerStats))
+  get_frame_scheduler_stats(stats)
+  return FrameSchedulerStats(stats...)
+end
+
+"""
+Duration in milliseconds of each phase of the startup of the last application, up to the first frame that was shown.
+Phases that did not happen, such as the creation of the engine when it is reused, are `NaN`.
+"""
+immutable StartupTimings
+  init_application_ms::Float64
+  create_engine_ms::Float64
+  load_ms::Float64
+  first_frame_ms::Float64
+end
+
+function Base.show(io::IO, t::StartupTimings)
+  total = 0.0
+  for (i, phase) in enumerate(("init_application", "create_engine", "load", "first_frame"))
+    ms = getfield(t, i)
+    @printf(io, "%-18s %10.3f ms\n", phase, ms)
+    if !isnan(ms)
+      total += ms
+    end
+  end
+  @printf(io, "%-18s %10.3f ms", "total", total)
+end
+
+"""
+Get the `StartupTimings` of the last application
+"""
+function startup_timings()
+  timings = zeros(nfields(StartupTimings))
+  get_startup_timings(timings)
+  return StartupTimings(timings...)
+end
+
+"""
+Start an asynchronous call from QML in a new task. Called from C++, which gets the result back through
+`async_call_finished` or `async_call_failed`.
+"""
+function start_async_call(id::Int32, f, args::Vector{Any})
+  @schedule begin
+    task_local_storage(:qml_async_call, id)
+    try
+      async_call_finished(id, f(args...))
+    catch e
+      async_call_failed(id, sprint(showerror, e))
+    end
+  end
+  return
+end
+
+"""
+Check if the asynchronous call from QML that runs in the current task was cancelled. Long-running functions
+called using `Julia.async` or `Qt.julia.callAsync` can poll this to stop early.
+"""
+function async_cancelled()
+  id = get(task_local_storage(), :qml_async_call, nothing)
+  return id != nothing && async_call_cancelled(id)
+end
+
+@doc """
+Enable or disable recording of the calls between QML and Julia: functions called from QML, ListModel role reads
+and writes, emitted signals, JuliaObject property changes and paint and render callbacks. Measurements are read
+using `profile_report` and cleared using `reset_profile`.
+""" set_profiling
+
+@doc "Clear all measurements made since profiling was enabled" reset_profile
+
+start_tracing() = start_tracing(65536)
+
+@doc """
+Start recording a timeline of the calls between QML and Julia, Qt event processing from `exec_async` and garbage collections.
+For each thread, only the last `capacity` events are kept (65536 by default). Starting clears any previously recorded events.
+""" start_tracing
+
+@doc "Stop recording the timeline started using `start_tracing`, keeping the recorded events" stop_tracing
+
+@doc """
+Write the recorded timeline to the given file in the Chrome trace event JSON format, which can be opened in Perfetto or
+`chrome://tracing`. Returns the number of written events.
+""" write_trace
+
 """
-macro qmlfunction(fname...)
-  esc(:(QML.register_function($(Any[string(f) for f in fname]))))
+Call count and latency statistics for one function, role, signal, property or callback, with times in nanoseconds
+"""
+immutable ProfileEntry
+  category::String
+  name::String
+  count::Int64
+  total_ns::Int64
+  max_ns::Int64
+  p50_ns::Int64
+  p90_ns::Int64
+  p99_ns::Int64
+end
+
+"""
+Table of `ProfileEntry`, sorted by decreasing total time
+"""
+immutable ProfileReport
+  entries::Vector{ProfileEntry}
+end
+
+Base.length(r::ProfileReport) = length(r.entries)
+Base.getindex(r::ProfileReport, i) = r.entries[i]
+Base.start(r::ProfileReport) = start(r.entries)
+Base.next(r::ProfileReport, state) = next(r.entries, state)
+Base.done(r::ProfileReport, state) = done(r.entries, state)
+
+function Base.show(io::IO, r::ProfileReport)
+  @printf(io, "%-10s %-30s %10s %12s %10s %10s %10s %10s\n", "category", "name", "count", "total (ms)", "p50 (µs)", "p90 (µs)", "p99 (µs)", "max (µs)")
+  for e in r.entries
+    @printf(io, "%-10s %-30s %10d %12.3f %10.1f %10.1f %10.1f %10.1f\n", e.category, e.name, e.count, e.total_ns/1e6, e.p50_ns/1e3, e.p90_ns/1e3, e.p99_ns/1e3, e.max_ns/1e3)
+  end
+end
+
+"""
+Get the measurements recorded since profiling was enabled using `set_profiling(true)`, merged over all threads
+"""
+function profile_report()
+  entries = ProfileEntry[]
+  visit_profile((args...) -> (push!(entries, ProfileEntry(args...)); nothing))
+  sort!(entries, by = e -> e.total_ns, rev = true)
+  return ProfileReport(entries)
+end
+
+"""
+Number of Julia values kept alive by one owner, such as an engine or a `ListModel`
+"""
+immutable GCRootCount
+  owner::String
+  live::Int64
+  peak::Int64
+end
+
+"""
+Get the number of Julia values currently protected from garbage collection by each engine, `ListModel` and `JuliaSignals`
+block and by the `JuliaObject` wrappers, in order
+of creation, together with the highest number protected at any time. A count that keeps growing points to a leak.
+"""
+function gc_root_counts()
+  counts = GCRootCount[]
+  visit_gc_roots((args...) -> (push!(counts, GCRootCount(args...)); nothing))
+  return counts
 end
 
 """
-Load the given QML path using a QQmlApplicationEngine, initializing the context with the given properties
+Load the given QML path using a QQmlApplicationEngine, initializing the context with the given properties.
+In persistent mode (see `set_persistent`) the engine and the compiled QML are reused and each call opens a new window.
 """
 macro qmlapp(path, context_properties...)
   esc(:(QML.load_qml_app($path, $(Any[string(p) for p in context_properties]), Any[$(context_properties...)])))
 end
 
+"""
+Load the QML file at `path` as the scene of the offscreen renderer `r`, replacing the previous scene. The keyword arguments
+are set as context properties of the new scene. The root of the QML file must be an `Item`, and it is resized to the size of the renderer.
+"""
+function load_scene(r::OffscreenRenderer, path::AbstractString; context_properties...)
+  load_scene(r, path, Any[string(k) for (k,v) in context_properties], Any[v for (k,v) in context_properties])
+end
+
+Base.size(r::OffscreenRenderer) = (Int(width(r)), Int(height(r)))
+
+"""
+Render `nframes` frames of the current scene of `r` into `image`, which must be a `Matrix{UInt32}` with the size of the renderer.
+Each element is a premultiplied `0xAARRGGBB` pixel, with `image[x,y]` the pixel in column `x` and row `y` counting from the top.
+"""
+function render_image!(image::Matrix{UInt32}, r::OffscreenRenderer, nframes::Integer=1)
+  if size(image) != size(r)
+    throw(DimensionMismatch("image size $(size(image)) does not match renderer size $(size(r))"))
+  end
+  render_frames(r, nframes, vec(image))
+  return image
+end
+
+"""
+Render `nframes` frames of the current scene of `r`, returning the last one as a new `Matrix{UInt32}` (see `render_image!`)
+"""
+render_image(r::OffscreenRenderer, nframes::Integer=1) = render_image!(Matrix{UInt32}(size(r)...), r, nframes)
+
+"""
+Show `image` in the display `d`, with `image[x,y]` the non-premultiplied `0xAARRGGBB` pixel in column `x` and row `y`
+counting from the top. Unlike `display`, the pixels are copied as they are, without
+encoding them as PNG, so this is the fastest way to show images that change often.
+"""
+load_rgba(d::JuliaDisplay, image::Matrix{UInt32}) = load_rgba(d, vec(image), Int32(size(image,1)), Int32(size(image,2)))
+
+"""
+Show `image` in the display `d`, with each element an opaque `0xffRRGGBB` pixel (see `load_rgba`)
+"""
+load_rgb24(d::JuliaDisplay, image::Matrix{UInt32}) = load_rgb24(d, vec(image), Int32(size(image,1)), Int32(size(image,2)))
+
+"""
+Show the grayscale image `image` in the display `d`, with one byte per pixel (see `load_rgba`)
+"""
+load_gray(d::JuliaDisplay, image::Matrix{UInt8}) = load_gray(d, vec(image), Int32(size(image,1)), Int32(size(image,2)))
+
 function Base.display(d::JuliaDisplay, x)
   buf = IOBuffer()
   Base.show(buf, MIME"image/png"(), x)
@@ -116,7 +389,7 @@ function Base.displayable(d::JuliaDisplay, mime::AbstractString)
   return false
 end
 
-export @qmlget, @qmlset, @emit, @qmlfunction, @qmlapp
+export @qmlget, @qmlset, @emit, @qmlfunction, @qmlapp, async_cancelled, profile_report, gc_root_counts, frame_scheduler_stats, startup_timings, load_scene, render_image, render_image!, load_rgba, load_rgb24, load_gray
 
 has_glvisualize = false
 
@@ -172,6 +445,55 @@ set_context_property(root_ctx, "my_property", 1)
 You can now use `my_property` in QML and every time `set_context_property` is called on it the GUI gets notified.
 """ set_context_property
 
+@doc """
+Set the context properties with the given names to the given values in one go, so QML bindings that depend on several of them
+are re-evaluated only once. Requires Qt 5.11, older versions set the properties one at a time.
+
+Example:
+```julia
+set_context_properties(qmlcontext(), ["temperature", "pressure"], [21.5, 1013.])
+```
+""" set_context_properties
+
+@doc """
+Set the maximum number of asynchronous calls from QML that run at the same time. Further calls wait until a running call finishes.
+""" set_max_async_calls
+
+@doc """
+Keep the application and the QML engine alive after `exec` returns, so later calls to `@qmlapp` reuse the engine and the
+compiled QML files instead of starting over. Quitting from QML then only closes the windows. Setting this to `false`
+releases the engine the next time an application is started.
+""" set_persistent
+
+@doc """
+Drop the compiled QML files kept by the persistent engine, so they are reloaded from disk when they are opened again.
+With a path argument only that file is dropped.
+""" invalidate_qml_cache
+
+@doc "Close the windows opened by `@qmlapp` in persistent mode" close_windows
+
+@doc """
+Notify QML of all changes made in Julia to the fields of the object wrapped by the given `JuliaObject`, including fields of nested objects,
+since the last `refresh` or the last write from QML or `@qmlset`. Only fields that actually changed emit a change signal, and nothing is
+written back to Julia. Returns the number of changed fields.
+""" refresh
+
+@doc """
+Create an `OffscreenRenderer` that renders QML scenes of the given size in pixels to memory, without showing a window or running
+`exec`. It uses the engine of the application, so QML files are compiled only once. Load a scene using `load_scene` and
+render it using `render_image`. The renderer is deleted together with the application, e.g. at the end of `exec`, after which
+using it throws an error.
+""" init_offscreen_renderer
+
+@doc "Change the size of the images rendered by an `OffscreenRenderer`" set_size
+
+@doc """
+Compile all QML files in the given directory and its subdirectories, so the compiled code is stored in the QML disk cache
+(Qt 5.9 or later) and later applications start without compiling. Returns the number of files compiled without errors.
+With Qt 5.15 or later, the cache location can be set using the `QML_DISK_CACHE_PATH` environment variable before the first
+application is started.
+""" precompile_qml
+
 @doc "Equivalent to [`QQmlEngine::rootContext`](http://doc.qt.io/qt-5/qqmlengine.html#rootContext)" root_context
 
 @doc """
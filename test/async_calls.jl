@@ -0,0 +1,52 @@
+using Base.Test
+using QML
+
+# Test asynchronous calls from QML
+
+function slow_add(a, b)
+  sleep(0.1)
+  return a + b
+end
+
+function failing_function()
+  error("expected failure")
+end
+
+function cancelled_function()
+  sleep(0.1)
+  return 1
+end
+
+async_results = []
+errors = []
+test_done = false
+
+function check_async_result(x)
+  push!(async_results, x)
+  nothing
+end
+
+function check_async_error(message)
+  push!(errors, message)
+  nothing
+end
+
+function finish_test()
+  global test_done
+  test_done = true
+  nothing
+end
+
+@qmlfunction slow_add failing_function cancelled_function check_async_result check_async_error finish_test
+@qmlapp joinpath(dirname(@__FILE__), "qml", "async_calls.qml")
+
+# The asynchronous calls run as Julia tasks, so keep Julia's event loop running
+exec_async()
+while !test_done
+  sleep(0.01)
+end
+
+@test async_results == [3, 7]
+@test length(errors) == 2
+@test any(e -> contains(e, "expected failure"), errors)
+@test any(e -> contains(e, "missing_function was not found"), errors)
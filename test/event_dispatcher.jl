@@ -0,0 +1,26 @@
+using Base.Test
+using QML
+
+# Timers and calls into Julia under a blocking exec. Printing waits for libuv to write the output,
+# which must work from a function called by a timer, since the timer itself was found by libuv.
+
+nb_ticks = 0
+printed = IOBuffer()
+
+function tick()
+  global nb_ticks
+  nb_ticks += 1
+  println("tick ", nb_ticks)
+  # Julia I/O that yields to the scheduler, as a file or a socket would
+  write(printed, "tick $nb_ticks\n")
+  sleep(0.001)
+  nb_ticks
+end
+
+@qmlfunction tick
+
+@qmlapp joinpath(dirname(@__FILE__), "qml", "event_dispatcher.qml")
+exec()
+
+@test nb_ticks == 10
+@test length(split(strip(takebuf_string(printed)), "\n")) == 10
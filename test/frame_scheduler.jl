@@ -0,0 +1,35 @@
+using Base.Test
+using QML
+
+# Test Julia work items run in the time left in between the frames of a window, also when they are queued before the application exists
+
+nb_steps = 0
+
+function work_step()
+  global nb_steps
+  nb_steps += 1
+  # Longer than half the budget, so the work is spread over several frames
+  Libc.systemsleep(0.0015)
+  return nb_steps < 10
+end
+
+work_done() = nb_steps >= 10
+
+set_frame_budget(2.0)
+reset_frame_scheduler_stats()
+schedule_work(work_step)
+
+@qmlfunction work_done
+
+qmlfile = joinpath(dirname(@__FILE__), "qml", "frame_scheduler.qml")
+@qmlapp qmlfile
+exec()
+
+@test nb_steps == 10
+stats = frame_scheduler_stats()
+@test stats.budget_ms == 2.0
+@test stats.nb_items_run == 10
+@test stats.nb_frames > 1
+@test stats.nb_deferred_frames > 0
+@test stats.mean_used_ms > 0
+@test stats.max_used_ms > 0
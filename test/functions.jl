@@ -34,10 +34,87 @@ function test_qvariant_map(m::QVariantMap)
   nothing
 end
 
+# Show raw pixels in all supported formats, reading them back to check the format and the order of the pixels
+displayed(d::JuliaDisplay, w, h) = UInt32[QML.display_pixel(d, x, y) for x in 1:w, y in 1:h]
+
+function show_pixels(d::JuliaDisplay)
+  # Every pixel is different, so a transposed or shifted copy is detected
+  rgba = UInt32[0x80000000 | UInt32(x) << 16 | UInt32(y) for x in 1:5, y in 1:3]
+  load_rgba(d, rgba)
+  @test displayed(d, 5, 3) == rgba
+
+  # The alpha byte is ignored
+  rgb = UInt32[UInt32(x) << 8 | UInt32(y) for x in 1:5, y in 1:3]
+  load_rgb24(d, rgb)
+  @test displayed(d, 5, 3) == rgb .| 0xff000000
+
+  # Width not a multiple of 4, so copied line by line
+  gray = UInt8[10*x + y for x in 1:5, y in 1:3]
+  load_gray(d, gray)
+  @test displayed(d, 5, 3) == UInt32[0xff000000 | UInt32(g) * 0x00010101 for g in gray]
+  nothing
+end
+
+function check_batch(ok1, value1, ok2, ok3, error3)
+  @test ok1
+  @test value1 == 5
+  @test ok2
+  @test !ok3
+  @test contains(error3, "not found")
+  nothing
+end
+
+nb_pure_calls = 0
+function pure_square(x)
+  global nb_pure_calls
+  nb_pure_calls += 1
+  return x*x
+end
+
+# Arguments containing objects can't be part of a cache key, so each call goes to Julia
+function pure_length(x)
+  global nb_pure_calls
+  nb_pure_calls += 1
+  return length(x)
+end
+
+# Results holding objects are not cached, since the objects may be deleted
+type PureStructTest
+  x::Int32
+end
+pure_struct = PureStructTest(1)
+nb_pure_struct_calls = 0
+function pure_structs(n)
+  global nb_pure_struct_calls
+  nb_pure_struct_calls += 1
+  o = @qmlget qmlcontext().pure_struct
+  return Any[o for i in 1:n]
+end
+
+# Registered before it exists: the failed lookup is remembered until the function is registered again
+late_results = []
+function define_late_function()
+  @eval late_function() = 42
+  @qmlfunction late_function
+  nothing
+end
+
+function check_late_function(missing_before, after)
+  push!(late_results, missing_before, after)
+  nothing
+end
+
+@qmlfunction late_function define_late_function check_late_function
+
 set_state2 = TestModuleFunction.set_state2
-@qmlfunction julia_callback1 julia_callback2 return_callback check_return_callback test_qvariant_map set_state1 set_state2
-@qmlapp joinpath(dirname(@__FILE__), "qml", "functions.qml")
+@qmlfunction julia_callback1 julia_callback2 return_callback check_return_callback show_pixels test_qvariant_map set_state1 set_state2 check_batch
+@qmlfunction pure=true pure_square pure_length pure_structs
+set_profiling(true)
+start_tracing()
+@qmlapp joinpath(dirname(@__FILE__), "qml", "functions.qml") pure_struct
 exec()
+set_profiling(false)
+stop_tracing()
 
 stringresult = VERSION < v"0.5-dev" ? ASCIIString : String
 
@@ -54,3 +131,28 @@ stringresult = VERSION < v"0.5-dev" ? ASCIIString : String
 @test call_results2 == [3., 6, "ab"]
 
 @test get_state() == 2
+
+report = profile_report()
+callback1_entries = filter(e -> e.category == "call" && e.name == "julia_callback1", report.entries)
+@test length(callback1_entries) == 1
+@test callback1_entries[1].count == 5
+@test callback1_entries[1].p50_ns <= callback1_entries[1].max_ns
+pure_square_entries = filter(e -> e.category == "call" && e.name == "pure_square", report.entries)
+@test length(pure_square_entries) == 1
+@test pure_square_entries[1].count == 4
+reset_profile()
+@test length(profile_report()) == 0
+
+trace_file = tempname()
+@test write_trace(trace_file) > 5
+trace_json = readstring(trace_file)
+@test startswith(trace_json, "{\"traceEvents\":[")
+@test contains(trace_json, "\"name\":\"julia_callback1\",\"cat\":\"call\"")
+rm(trace_file)
+
+@test nb_pure_calls == 5
+@test nb_pure_struct_calls == 2
+
+@test late_results == [true, 42]
+@test pure_cache_hits() == 2
+@test pure_cache_misses() == 4
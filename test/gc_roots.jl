@@ -0,0 +1,29 @@
+using Base.Test
+using QML
+
+# Test that ListModel roles are kept alive by the model and released when they are replaced or removed
+
+type GCRootsTestType
+  a::Int
+  b::Float64
+end
+
+function model_roots()
+  counts = filter(c -> c.owner == "ListModel", gc_root_counts())
+  return counts[end]
+end
+
+model = ListModel([GCRootsTestType(1, 2.), GCRootsTestType(3, 4.)])
+
+# array, update function, constructor and a getter and a setter for each field
+@test model_roots().live == 7
+
+setconstructor(model, identity)
+@test model_roots().live == 7
+
+removerole(model, "b")
+@test model_roots().live == 5
+@test model_roots().peak == 7
+
+addrole(model, "c", x -> 2*x.a)
+@test model_roots().live == 6
@@ -1,20 +1,109 @@
 using Base.Test
 using QML
 
-# example type
+# example types
+type JuliaTestSubType
+  b::Float64
+end
+
 type JuliaTestType
   a::Int32
+  sub::JuliaTestSubType
+  name::String
 end
 
 # absolute path in case working dir is overridden
 qml_file = joinpath(dirname(@__FILE__), "qml", "julia_object.qml")
 
-julia_object = JuliaTestType(0.)
+# Change the object in Julia and notify QML of the changes
+function mutate_and_refresh()
+  julia_object.a = 5
+  julia_object.sub.b = 10.
+  # A new string, compared by address against the old one
+  julia_object.name = "object 2"
+  return refresh(@qmlget qmlcontext().julia_object)
+end
+
+# Values read from QML before any change
+function check_initial(a, b, name)
+  @test a == 0
+  @test b == 1.5
+  @test name == "object"
+  nothing
+end
+
+# Values written from QML, as seen in Julia
+function check_written()
+  @test julia_object.a == 1
+  @test julia_object.sub.b == 3.
+  @test julia_object.name == "object 1"
+  nothing
+end
 
-# Run with qml file and one context property
-@qmlapp qml_file julia_object
+function check_refresh(nb_changed, a, b, name)
+  @test nb_changed == 3
+  @test a == 5
+  @test b == 10.
+  @test name == "object 2"
+  nothing
+end
+
+function check_identity(same_object, same_sub)
+  @test same_object
+  @test same_sub
+  nothing
+end
+
+@qmlfunction check_initial check_written mutate_and_refresh check_refresh check_identity
+
+# Objects that refer to each other, which must not keep each other's wrappers alive
+type CycleTestB
+  a
+end
+
+type CycleTestA
+  b::CycleTestB
+end
+
+function check_cycle(same_object)
+  @test same_object
+  # QML read cycle_a.b.a, so refreshing follows the cycle back to cycle_a, which must stop there
+  @test refresh(@qmlget qmlcontext().cycle_a) == 0
+  nothing
+end
+
+@qmlfunction check_cycle
+
+# Inline fields without a typed property, written through a conversion to the field type
+type InlineFieldTest
+  small::Int16
+  byte::UInt8
+end
+
+wrapper_roots() = filter(c -> c.owner == "JuliaObject", gc_root_counts())
+nb_wrappers_before = isempty(wrapper_roots()) ? 0 : wrapper_roots()[end].live
+
+julia_object = JuliaTestType(0., JuliaTestSubType(1.5), "object")
+cycle_a = CycleTestA(CycleTestB(nothing))
+cycle_a.b.a = cycle_a
+inline_fields = InlineFieldTest(1, 2)
+# The same Julia objects, which must map to the same QML objects
+same_object = julia_object
+same_sub = julia_object.sub
+
+# Run with qml file and context properties
+@qmlapp qml_file julia_object same_object same_sub cycle_a inline_fields
 
 # Run the application
 exec()
 
-@test julia_object.a == 1
+@test julia_object.a == 5
+@test julia_object.sub.b == 10.
+@test julia_object.name == "object 2"
+
+@test inline_fields.small == 300
+@test inline_fields.byte == 2 # 1000 does not fit, so the write is refused
+
+# All wrappers, including those of the cycle, are gone together with the context
+@test wrapper_roots()[end].live == nb_wrappers_before
+@test wrapper_roots()[end].peak >= 4
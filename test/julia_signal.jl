@@ -9,6 +9,55 @@ function emit_signal2()
   @emit testsignalargs(2., "Hi from Julia")
 end
 
+function emit_signal3()
+  @emit testsignalarray([1.0, 2.0, 3.0], Int32[4, 5])
+end
+
+function emit_signal4()
+  @emit testsignalmanyargs(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12)
+end
+
+type SignalTestType
+  a::Int32
+end
+
+function emit_signal5()
+  @emit testsignalobject(SignalTestType(3))
+  # Objects can't be queued, this fails with an error instead of dropping the emission
+  @test_throws ErrorException emit_queued("testsignalobject", Any[SignalTestType(4)])
+end
+
+function emit_signal6()
+  emit_queued("testsignalqueued", Any[6])
+  # An Int64 that doesn't fit in the int parameter is refused instead of wrapping around
+  @test_throws ErrorException @emit testsignalqueued(2^40)
+end
+
+function emit_signal7()
+  coalesce_signal("testsignalcoalesced", 10.0)
+  for i in 1:100
+    @emit testsignalcoalesced(i)
+  end
+end
+
+# Emitting from worker threads goes through the queue when Julia runs with several threads
+function emit_signal8()
+  Threads.@threads for i in 1:8
+    @emit testsignalthreaded(i)
+  end
+end
+
+# Switching coalescing off delivers the held back emission, which counts as delivered
+function emit_signal9()
+  coalesce_signal("testsignalflushed", 1.0)
+  @emit testsignalflushed(1)
+  @emit testsignalflushed(2)
+  @test signal_delivered_count("testsignalflushed") == 1
+  coalesce_signal("testsignalflushed", 0.0)
+  @test signal_delivered_count("testsignalflushed") == 2
+  @test signal_dropped_count("testsignalflushed") == 0
+end
+
 function check1(result::Bool)
   @test result
   nothing
@@ -20,9 +69,69 @@ function check2(x::Float64, s::AbstractString)
   nothing
 end
 
+array_sum = 0.0
+function check3(x, y)
+  global array_sum
+  array_sum = sum(x) + sum(y)
+  nothing
+end
+
+many_args = Int32[]
+function check4(args)
+  global many_args
+  many_args = Int32[a for a in args]
+  nothing
+end
+
+object_value = 0
+function check5(a)
+  global object_value
+  object_value = a
+  nothing
+end
+
 @qmlfunction emit_signal1
 @qmlfunction emit_signal2
-@qmlfunction check1 check2
+queued_value = 0
+function check6(x)
+  global queued_value
+  queued_value = x
+  nothing
+end
+
+coalesced_values = Int32[]
+nb_dropped = 0
+nb_held_roots = 0
+function check7(x)
+  global nb_dropped, nb_held_roots
+  push!(coalesced_values, x)
+  nb_dropped = signal_dropped_count("testsignalcoalesced")
+  # Only the last held back value is kept, the dropped ones were never converted
+  nb_held_roots = filter(c -> c.owner == "JuliaSignals", gc_root_counts())[end].peak
+  nothing
+end
+
+flushed_values = Int32[]
+function check9(x)
+  push!(flushed_values, x)
+  nothing
+end
+
+kept_value = 0
+function check_kept(a)
+  global kept_value
+  kept_value = a
+  nothing
+end
+
+threaded_values = Int32[]
+function check8(x)
+  push!(threaded_values, x)
+  nothing
+end
+
+@qmlfunction emit_signal3 emit_signal4 emit_signal5 emit_signal6 emit_signal7 emit_signal8 emit_signal9
+@qmlfunction check1 check2 check3 check4 check5 check6 check7 check8 check9 check_kept
 
 # absolute path in case working dir is overridden
 qml_file = joinpath(dirname(@__FILE__), "qml", "julia_signal.qml")
@@ -31,3 +140,14 @@ qml_file = joinpath(dirname(@__FILE__), "qml", "julia_signal.qml")
 
 # Run the application
 exec()
+
+@test array_sum == 15.0
+@test many_args == collect(1:12)
+@test object_value == 3
+@test kept_value == 3
+@test queued_value == 6
+@test coalesced_values == [1, 100]
+@test nb_dropped == 98
+@test nb_held_roots == 1
+@test sort(threaded_values) == collect(1:8)
+@test flushed_values == [1, 2]
@@ -0,0 +1,26 @@
+using Base.Test
+using QML
+
+# Render scenes to memory without a window, reusing the renderer for each scene
+
+qml_file = joinpath(dirname(@__FILE__), "qml", "offscreen.qml")
+
+renderer = init_offscreen_renderer(64, 32)
+@test size(renderer) == (64, 32)
+
+for (fill_color, expected) in (("red", 0xffff0000), ("blue", 0xff0000ff))
+  load_scene(renderer, qml_file, fill_color=fill_color)
+  img = render_image(renderer)
+  @test size(img) == (64, 32)
+  # The top half is green, so this also checks that the first row is the top of the image
+  @test img[1,1] == 0xff00ff00
+  @test img[64,32] == expected
+end
+
+set_size(renderer, 16, 16)
+@test size(render_image(renderer, 2)) == (16, 16)
+
+# Cleaning up the application deletes the renderer, after which it can no longer be used
+load_scene(renderer, joinpath(dirname(@__FILE__), "qml", "offscreen_quit.qml"))
+exec()
+@test_throws ErrorException size(renderer)
@@ -0,0 +1,46 @@
+using Base.Test
+using QML
+
+# Test that the engine and the compiled QML are reused when running the same application twice
+
+runs = Int[]
+
+function app_started(run_number)
+  push!(runs, run_number)
+  return
+end
+
+@qmlfunction app_started
+
+set_persistent(true)
+
+# Work on a copy, since the test changes the file
+qmlfile = joinpath(tempdir(), "persistent_engine_test.qml")
+cp(joinpath(dirname(@__FILE__), "qml", "persistent_engine.qml"), qmlfile, remove_destination=true)
+for run_number in 1:2
+  @qmlapp qmlfile run_number
+  exec()
+end
+
+@test runs == [1,2]
+
+# The engine created for the windows is the one @qmlapp uses
+@test isa(init_qmlapplicationengine(), QML.QQmlApplicationEngine)
+
+# Changes on disk are only picked up after invalidating the cache
+write(qmlfile, replace(readstring(qmlfile), "Julia.app_started(run_number)", "Julia.app_started(10*run_number)"))
+run_number = 3
+@qmlapp qmlfile run_number
+exec()
+@test runs == [1,2,3]
+
+invalidate_qml_cache(qmlfile)
+run_number = 4
+@qmlapp qmlfile run_number
+exec()
+@test runs == [1,2,3,40]
+
+rm(qmlfile)
+
+# Later tests get a fresh engine
+set_persistent(false)
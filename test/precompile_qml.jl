@@ -0,0 +1,8 @@
+using Base.Test
+using QML
+
+# Compile the test QML files ahead of time, storing them in the QML disk cache
+qmldir = joinpath(dirname(@__FILE__), "qml")
+nb_files = length(filter(f -> endswith(f, ".qml"), readdir(qmldir)))
+nb_compiled = precompile_qml(qmldir)
+@test 0 < nb_compiled <= nb_files
@@ -8,9 +8,20 @@ function check_property(x)
   nothing
 end
 
-@qmlfunction check_property
+function check_properties(a, b)
+  @test a == 2
+  @test b == "three"
+  nothing
+end
+
+@qmlfunction check_property check_properties
 qmlfile = joinpath(dirname(@__FILE__), "qml", "properties.qml")
 
 my_prop = 1
 @qmlapp qmlfile my_prop
+
+# Set several properties at once after loading
+set_context_properties(qmlcontext(), ["prop_a", "prop_b"], [2, "three"])
+@test (@qmlget qmlcontext().prop_a) == 2
+@test (@qmlget qmlcontext().prop_b) == "three"
 exec()
@@ -0,0 +1,25 @@
+import QtQuick 2.0
+import org.julialang 1.0
+
+Timer {
+  interval: 200; running: true; repeat: false
+  property int nb_pending: 4
+
+  function finish_one() {
+    nb_pending -= 1
+    if(nb_pending === 0) {
+      Julia.finish_test()
+      Qt.quit()
+    }
+  }
+
+  onTriggered: {
+    Qt.julia.maxAsyncCalls = 1
+    var cancelled = Qt.julia.callAsync("cancelled_function", [], function(x) { Julia.check_async_result(-1) })
+    Qt.julia.cancelAsync(cancelled)
+    Julia.async.slow_add(1, 2, function(x) { Julia.check_async_result(x); finish_one() })
+    Qt.julia.callAsync("slow_add", [3, 4], function(x) { Julia.check_async_result(x); finish_one() })
+    Julia.async.failing_function(function(x) {}, function(message) { Julia.check_async_error(message); finish_one() })
+    Qt.julia.callAsync("missing_function", [], function(x) {}, function(message) { Julia.check_async_error(message); finish_one() })
+  }
+}
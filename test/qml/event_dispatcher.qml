@@ -0,0 +1,14 @@
+import QtQuick 2.0
+import org.julialang 1.0
+
+Item {
+  Timer {
+    interval: 10; running: true; repeat: true
+    onTriggered: {
+      if(Julia.tick() === 10) {
+        running = false
+        Qt.quit()
+      }
+    }
+  }
+}
@@ -0,0 +1,26 @@
+import QtQuick 2.0
+import QtQuick.Window 2.2
+import org.julialang 1.0
+
+Window {
+  visible: true
+  width: 100
+  height: 100
+
+  // Keeps the window rendering frames
+  Rectangle {
+    width: 50
+    height: 50
+    color: "blue"
+    NumberAnimation on rotation { from: 0; to: 360; duration: 1000; loops: Animation.Infinite }
+  }
+
+  Timer {
+    interval: 50; running: true; repeat: true
+    onTriggered: {
+      if(Julia.work_done()) {
+        Qt.quit()
+      }
+    }
+  }
+}
@@ -22,11 +22,31 @@ Item {
 
       Julia.check_return_callback(Julia.return_callback())
 
+      Julia.show_pixels(jdisp)
+
       Julia.test_qvariant_map({"somekey": "somevalue"})
 
       Julia.set_state1()
       Julia.set_state2()
 
+      var batch = Qt.julia.callBatch([["return_callback"], ["check_return_callback", [5]], ["no_such_function", []]])
+      Julia.check_batch(batch[0].ok, batch[0].value, batch[1].ok, batch[2].ok, batch[2].error)
+
+      var late_before = Julia.late_function()
+      Julia.define_late_function()
+      Julia.check_late_function(late_before === undefined, Julia.late_function())
+      Qt.julia.call("no_such_function_" + Math.floor(Math.random() * 1000), []) // warns without adding a handle
+
+      Julia.pure_square(3)
+      Julia.pure_square(4)
+      Julia.pure_square(3)
+      Julia.check_return_callback(Julia.pure_square(3) - 4)
+      Julia.pure_length([jdisp])
+      Julia.pure_length([jdisp])
+      Julia.pure_length({"display": jdisp})
+      Julia.pure_structs(2)
+      Julia.check_return_callback(Julia.pure_structs(2)[1].x + 4)
+
       Qt.quit()
     }
   }
@@ -3,7 +3,16 @@ import QtQuick 2.0
 Timer {
      interval: 200; running: true; repeat: false
      onTriggered: {
+       Julia.check_initial(julia_object.a, julia_object.sub.b, julia_object.name)
+       Julia.check_identity(julia_object === same_object, julia_object.sub === same_sub)
+       Julia.check_cycle(cycle_a.b.a === cycle_a)
+       inline_fields.small = 300
+       inline_fields.byte = 1000
        julia_object.a = 1
+       julia_object.sub.b = julia_object.sub.b * 2 // nested object created on first access
+       julia_object.name = julia_object.name + " " + julia_object.a // typed properties read the Julia object directly
+       Julia.check_written()
+       Julia.check_refresh(Julia.mutate_and_refresh(), julia_object.a, julia_object.sub.b, julia_object.name)
        Qt.quit()
      }
  }
@@ -2,13 +2,40 @@ import QtQuick 2.0
 import org.julialang 1.0
 
 Item {
+  id: root
+  // An object argument that is still used after its signal was handled
+  property var keptObject: null
 
   JuliaSignals {
     signal testsignal()
     signal testsignalargs(real x, string s)
+    signal testsignalarray(var x, var y)
+    signal testsignalmanyargs(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9, int a10, int a11, int a12)
+    signal testsignalobject(var o)
+    signal testsignalqueued(int x)
+    signal testsignalcoalesced(int x)
+    signal testsignalthreaded(int x)
+    signal testsignalflushed(int x)
 
     onTestsignal: Julia.check1(true)
     onTestsignalargs: Julia.check2(x, s)
+    onTestsignalarray: Julia.check3(x, y)
+    onTestsignalmanyargs: Julia.check4([a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12])
+    onTestsignalobject: {
+      root.keptObject = o
+      Julia.check5(o.a)
+    }
+    onTestsignalqueued: Julia.check6(x)
+    onTestsignalthreaded: Julia.check8(x)
+    onTestsignalflushed: Julia.check9(x)
+    onTestsignalcoalesced: {
+      Julia.check7(x)
+      if(x === 100) {
+        gc()
+        Julia.check_kept(root.keptObject.a)
+        Qt.quit()
+      }
+    }
   }
 
   Timer {
@@ -16,7 +43,13 @@ Item {
        onTriggered: {
          Julia.emit_signal1()
          Julia.emit_signal2()
-         Qt.quit()
+         Julia.emit_signal3()
+         Julia.emit_signal4()
+         Julia.emit_signal5()
+         Julia.emit_signal6()
+         Julia.emit_signal8()
+         Julia.emit_signal9()
+         Julia.emit_signal7() // quits when the last coalesced value arrives
        }
    }
 }
@@ -0,0 +1,10 @@
+import QtQuick 2.0
+
+Rectangle {
+  color: fill_color // Context property set from Julia
+
+  Rectangle {
+    width: parent.width; height: parent.height / 2
+    color: "#00ff00"
+  }
+}
@@ -0,0 +1,8 @@
+import QtQuick 2.0
+
+Item {
+  Timer {
+    interval: 10; running: true; repeat: false
+    onTriggered: Qt.quit()
+  }
+}
@@ -0,0 +1,14 @@
+import QtQuick 2.0
+import org.julialang 1.0
+
+Item {
+  width: 100; height: 100
+
+  Timer {
+    interval: 200; running: true; repeat: false
+    onTriggered: {
+      Julia.app_started(run_number)
+      Qt.quit()
+    }
+  }
+}
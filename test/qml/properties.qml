@@ -7,6 +7,7 @@ Item {
     interval: 200; running: true; repeat: false
     onTriggered: {
       Julia.check_property(my_prop)
+      Julia.check_properties(prop_a, prop_b)
       Qt.quit()
     }
   }
@@ -14,3 +14,7 @@ set_source(qview, qml_file)
 QML.show(qview)
 
 exec()
+
+# Each phase up to the first frame was measured
+timings = startup_timings()
+@test all(t -> !isnan(t) && t >= 0, [getfield(timings, i) for i in 1:nfields(timings)])
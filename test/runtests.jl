@@ -4,7 +4,7 @@ excluded = []
 
 # OpenGL on Linux travis is excessively old, causing a crash when attempting display of a window
 if get(ENV, "QML_SKIP_GUI_TESTS", "0") != "0"
-  excluded = ["listviews.jl", "qqmlcomponent.jl", "qquickview.jl"]
+  excluded = ["listviews.jl", "qqmlcomponent.jl", "qquickview.jl", "persistent_engine.jl", "offscreen.jl", "frame_scheduler.jl"]
 end
 
 for fname in readdir()